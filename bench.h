@@ -0,0 +1,124 @@
+/*
+ * Benchmark support shared by the puzzle programs.
+ *
+ * Compiling a puzzle with -DBENCH (see the bench target in the Makefile)
+ * replaces its sample-case main() with one that generates seeded inputs at
+ * the constraint limits and times the solver with the BENCH_CASE() macro below.
+ * Each timed case prints a single line of JSON to stdout, e.g.
+ *
+ *   {"program":"hops","case":"random","n":500000,"reps":5,"seed":1,
+ *    "best_s":0.000712,"mean_s":0.000731,"ns_per_elem":1.424,
+ *    "elems_per_sec":7.02e+08,"max_rss_kb":13120,"result":999999998785}
+ *
+ * where ns_per_elem and elems_per_sec are derived from the best of the reps
+ * runs and max_rss_kb is the peak resident set size of the whole process so
+ * far.
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+
+static uint64_t bench_state, bench_seed_;
+
+
+/*
+ * Seed the generator; every case should seed so it can be reproduced alone.
+ */
+static inline void bench_seed(uint64_t seed) {
+    bench_state = bench_seed_ = seed;
+}
+
+
+/*
+ * SplitMix64, good enough for test data and identical on every platform.
+ */
+static inline uint64_t bench_rand(void) {
+    uint64_t z = (bench_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+
+/*
+ * Uniformly distributed integer in [lo,hi].
+ */
+static inline long long bench_range(long long lo, long long hi) {
+    return lo + (long long)(bench_rand() % (uint64_t)(hi - lo + 1));
+}
+
+
+/*
+ * Fisher-Yates shuffle, for inputs that are easiest to generate in order.
+ */
+static inline void bench_shuffle_ll(long long *a, int n) {
+    for (int i = n-1; i > 0; i--) {
+        int j = bench_range(0, i);
+        long long t = a[i]; a[i] = a[j], a[j] = t;
+    };
+}
+
+
+static inline double bench_now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9 * ts.tv_nsec;
+}
+
+
+static inline long bench_max_rss_kb(void) {
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+
+static inline void bench_report(const char *file, const char *name, long long n,
+        int reps, double best, double mean, double result)
+{
+    const char *base = strrchr(file, '/');
+    int len;
+
+    base = base ? base+1 : file;
+    len = strrchr(base, '.') ? (int)(strrchr(base, '.') - base) : (int)strlen(base);
+
+    printf("{\"program\":\"%.*s\",\"case\":\"%s\",\"n\":%lld,\"reps\":%d,"
+        "\"seed\":%llu,\"best_s\":%.6g,\"mean_s\":%.6g,\"ns_per_elem\":%.6g,"
+        "\"elems_per_sec\":%.6g,\"max_rss_kb\":%ld,\"result\":%.17g}\n",
+        len, base, name, n, reps, (unsigned long long)bench_seed_, best, mean,
+        1e9 * best / n, n / best, bench_max_rss_kb(), result);
+    fflush(stdout);
+}
+
+
+/*
+ * Time `call` reps times and report it as case `name` of size n.  `setup` is
+ * run before every repetition but not timed, so solvers which modify their
+ * input in place can be handed a fresh copy.
+ */
+#define BENCH_CASE(name, n, reps, setup, call) do {                         \
+    double best_ = 0.0, total_ = 0.0, result_ = 0.0;                        \
+    for (int rep_ = 0; rep_ < (reps); rep_++) {                             \
+        setup;                                                              \
+        double t_ = bench_now();                                            \
+        result_ = (double)(call);                                           \
+        t_ = bench_now() - t_;                                              \
+        total_ += t_;                                                       \
+        if (rep_ == 0 || t_ < best_)                                        \
+            best_ = t_;                                                     \
+    };                                                                      \
+    bench_report(__FILE__, name, n, reps, best_, total_/(reps), result_);   \
+} while (0)
+
+
+#endif
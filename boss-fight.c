@@ -34,29 +34,1071 @@
  * N = 4, H = {1,1,2,3}, D = {1,2,1,100}, B = 8     ->  result = 62.75
  */
 
+/*
+ * Solution
+ *
+ * With warrior i in front and warrior j as backup the boss takes H[i]/B
+ * seconds to defeat i and another H[j]/B seconds to defeat j, so the damage
+ * dealt is
+ *
+ *   ( H[i]*(D[i]+D[j]) + H[j]*D[j] ) / B  =  ( l_i(D[j]) + H[j]*D[j] ) / B
+ *
+ * where l_i(x) = H[i]*x + H[i]*D[i] is a line depending only on warrior i.
+ * For a fixed backup j we therefore need the maximum of the lines l_i at the
+ * point D[j], which a Li Chao tree over the values of D answers in O(log N).
+ * Inserting l_0, ..., l_{j-1} before querying j, and then doing the same in
+ * reverse order, covers every i != j in O(N log N) overall.
+ *
+ * With H, D <= 1e9 the numerator stays below 3e18 and so is computed exactly
+ * in a long long; only the final division is done in floating point.
+ */
+
+#include <immintrin.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 
+#include "parallel.h"
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
+
+#define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
 #define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
 
 
+typedef struct line {
+    long long a, b;                 // y = a*x + b
+} line_t;
+
+#define LINE_AT(l,x)    ( (l).a * (x) + (l).b )
+
+// evaluates to LLONG_MIN everywhere, so loses against any real line
+#define NO_LINE         ( (line_t){ 0, LLONG_MIN } )
+
+
+typedef struct lichao {
+    int size;                       // number of x-coordinates
+    long long *x;                   // [size] sorted distinct x-coordinates
+    line_t *line;                   // [4*size] one line per tree node
+} lichao_t;
+
+
+typedef struct warrior {
+    long long h, d;
+} warrior_t;
+
+
+int warrior_cmp(const void *x, const void *y) {
+    long long a = ((const warrior_t *)x)->d, b = ((const warrior_t *)y)->d;
+    return (a > b) - (a < b);
+}
+
+
+/*
+ * Create an empty Li Chao tree which can be queried at the n given points,
+ * which must be sorted in ascending order.
+ */
+lichao_t *lichao_new(int n, long long *x) {
+    lichao_t *t = malloc(sizeof *t);
+
+    t->x = malloc(n * sizeof *t->x);
+    t->size = 0;
+    for (int i = 0; i < n; i++)
+        if (t->size == 0 || x[i] != t->x[t->size-1])
+            t->x[t->size++] = x[i];
+
+    t->line = malloc(4 * t->size * sizeof *t->line);
+    for (int i = 0; i < 4 * t->size; i++)
+        t->line[i] = NO_LINE;
+
+    return t;
+}
+
+
+void lichao_delete(lichao_t *t) {
+    if (!t)
+        return;
+
+    free(t->line);
+    free(t->x);
+    free(t);
+}
+
+
+void lichao_clear(lichao_t *t) {
+    for (int i = 0; i < 4 * t->size; i++)
+        t->line[i] = NO_LINE;
+}
+
+
+void lichao_insert(lichao_t *t, line_t l) {
+    int node = 1, lo = 0, hi = t->size-1;
+
+    for (;;) {
+        int mid = (lo+hi) / 2;
+        line_t *cur = &t->line[node];
+        int wins_lo = LINE_AT(l, t->x[lo]) > LINE_AT(*cur, t->x[lo]);
+        int wins_mid = LINE_AT(l, t->x[mid]) > LINE_AT(*cur, t->x[mid]);
+
+        // keep the winner at mid here and push the loser down the half
+        // where it may still win
+        if (wins_mid) {
+            line_t tmp = *cur;
+            *cur = l, l = tmp;
+        };
+        if (lo == hi || l.b == LLONG_MIN)
+            return;
+
+        if (wins_lo != wins_mid)
+            node = 2*node, hi = mid;
+        else
+            node = 2*node+1, lo = mid+1;
+    };
+}
+
+
+/*
+ * Maximum of all inserted lines at x, which must be one of the points given
+ * to lichao_new().
+ */
+long long lichao_max(lichao_t *t, long long x) {
+    int node = 1, lo = 0, hi = t->size-1;
+    long long y = LLONG_MIN;
+
+    for (;;) {
+        int mid = (lo+hi) / 2;
+
+        y = MAX(y, LINE_AT(t->line[node], x));
+        if (lo == hi)
+            return y;
+
+        if (x <= t->x[mid])
+            node = 2*node, hi = mid;
+        else
+            node = 2*node+1, lo = mid+1;
+    };
+}
+
+
 double getMaxDamageDealt(int N, int *H, int *D, int B) {
-    double max_damage = 0.0;
-    double damage;
+    warrior_t *w = malloc(N * sizeof *w);
+    long long *x = malloc(N * sizeof *x);
+    long long max_damage = 0;
+
+    // visiting warriors by damage per second keeps consecutive queries on
+    // nearby paths through the tree
+    for (int i = 0; i < N; i++)
+        w[i].h = H[i], w[i].d = D[i];
+    qsort(w, N, sizeof *w, warrior_cmp);
+
+    for (int i = 0; i < N; i++)
+        x[i] = w[i].d;
+    lichao_t *t = lichao_new(N, x);
+    free(x);
+
+    for (int pass = 0; pass < 2; pass++) {
+        lichao_clear(t);
+        for (int k = 0; k < N; k++) {
+            int j = pass ? N-1-k : k;
+            long long h = w[j].h, d = w[j].d;
+
+            if (k > 0)
+                max_damage = MAX(max_damage, lichao_max(t, d) + h*d);
+            lichao_insert(t, (line_t){ h, h*d });
+        };
+    };
+
+    lichao_delete(t);
+    free(w);
+
+    return (double)max_damage / B;
+}
+
+
+/*
+ * Reference solution trying every pair of warriors in O(N^2).
+ */
+double getMaxDamageDealtPairwise(int N, int *H, int *D, int B) {
+    long long max_damage = 0;
+    long long damage;
 
     for (int i = 0; i < N; i++) {
         for (int j = 0; j < N; j++) {
             if (j == i)
                 continue;
-            damage = H[i] * (D[i] + D[j]) + H[j] * D[j];
+            damage = (long long)H[i] * (D[i] + D[j]) + (long long)H[j] * D[j];
             max_damage = MAX(max_damage, damage);
         };
     };
 
-    return max_damage / B;
+    return (double)max_damage / B;
+}
+
+
+/*
+ * Exhaustive oracle for checking the fast solvers on large inputs.
+ *
+ * This evaluates the same N^2 pairs as getMaxDamageDealtPairwise(), but on
+ * structure-of-arrays columns of 64-bit values: the warriors are split into
+ * blocks of ORACLE_ROWS front line warriors, which worker threads claim one
+ * at a time, and each block is run against tiles of ORACLE_TILE backups small
+ * enough to stay in L1.  Within a tile the AVX2 kernel handles four backups
+ * at once; since D[i] + D[j] < 2^32, the 32x32->64 bit multiply of AVX2 is
+ * exact.
+ */
+
+#define ORACLE_ROWS     64
+#define ORACLE_TILE     1024
+
+
+typedef struct oracle {
+    int N;
+    long long *h, *d, *hd;          // [N] H, D, and H*D
+    int num_blocks, next_block;     // blocks of front line warriors
+    long long *max_damage;          // [num_threads]
+    long long (*row_max)(long long h, long long d,
+        const long long *D, const long long *HD, int n);
+} oracle_t;
+
+
+/*
+ * Maximum of h*(d + D[j]) + HD[j] over j < n.
+ */
+long long oracle_row_max(long long h, long long d,
+        const long long *D, const long long *HD, int n)
+{
+    long long max_damage = 0;
+
+    for (int j = 0; j < n; j++)
+        max_damage = MAX(max_damage, h * (d + D[j]) + HD[j]);
+
+    return max_damage;
+}
+
+
+__attribute__((target("avx2")))
+long long oracle_row_max_avx2(long long h, long long d,
+        const long long *D, const long long *HD, int n)
+{
+    __m256i vh = _mm256_set1_epi64x(h), vd = _mm256_set1_epi64x(d);
+    __m256i vmax[4];
+    long long m[4];
+    int j;
+
+    // four independent maxima to hide the compare and blend latency
+    for (int k = 0; k < 4; k++)
+        vmax[k] = _mm256_setzero_si256();
+
+    for (j = 0; j+16 <= n; j += 16) {
+        for (int k = 0; k < 4; k++) {
+            __m256i dj = _mm256_loadu_si256((const __m256i *)(D+j+4*k));
+            __m256i hdj = _mm256_loadu_si256((const __m256i *)(HD+j+4*k));
+            __m256i v = _mm256_add_epi64(
+                _mm256_mul_epu32(vh, _mm256_add_epi64(vd, dj)), hdj);
+            vmax[k] = _mm256_blendv_epi8(vmax[k], v, _mm256_cmpgt_epi64(v, vmax[k]));
+        };
+    };
+
+    for (int k = 1; k < 4; k++)
+        vmax[0] = _mm256_blendv_epi8(vmax[0], vmax[k], _mm256_cmpgt_epi64(vmax[k], vmax[0]));
+    _mm256_storeu_si256((__m256i *)m, vmax[0]);
+    m[0] = MAX(MAX(m[0], m[1]), MAX(m[2], m[3]));
+
+    return MAX(m[0], oracle_row_max(h, d, D+j, HD+j, n-j));
+}
+
+
+void oracle_worker(void *arg, int t, int num_threads) {
+    oracle_t *o = arg;
+    long long max_damage = 0;
+    int b;
+
+    (void)num_threads;
+
+    while ((b = __atomic_fetch_add(&o->next_block, 1, __ATOMIC_RELAXED)) < o->num_blocks) {
+        int i0 = b * ORACLE_ROWS, i1 = MIN(i0 + ORACLE_ROWS, o->N);
+
+        for (int j0 = 0; j0 < o->N; j0 += ORACLE_TILE) {
+            int j1 = MIN(j0 + ORACLE_TILE, o->N);
+
+            for (int i = i0; i < i1; i++) {
+                long long h = o->h[i], d = o->d[i];
+
+                // skip the diagonal, warrior i can't back themselves up
+                if (i < j0 || i >= j1) {
+                    max_damage = MAX(max_damage,
+                        o->row_max(h, d, o->d+j0, o->hd+j0, j1-j0));
+                } else {
+                    max_damage = MAX(max_damage,
+                        o->row_max(h, d, o->d+j0, o->hd+j0, i-j0));
+                    max_damage = MAX(max_damage,
+                        o->row_max(h, d, o->d+i+1, o->hd+i+1, j1-i-1));
+                };
+            };
+        };
+    };
+
+    o->max_damage[t] = max_damage;
+}
+
+
+/*
+ * Same result as getMaxDamageDealtPairwise() on the given number of threads,
+ * or parallel_threads() if that is <= 0.
+ */
+double getMaxDamageDealtOracle(int N, int *H, int *D, int B, int num_threads) {
+    oracle_t o = {
+        .N = N,
+        .num_blocks = (N + ORACLE_ROWS-1) / ORACLE_ROWS, .next_block = 0,
+        .row_max = __builtin_cpu_supports("avx2") ? oracle_row_max_avx2 : oracle_row_max,
+    };
+    long long max_damage = 0;
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+
+    o.h = malloc(N * sizeof *o.h);
+    o.d = malloc(N * sizeof *o.d);
+    o.hd = malloc(N * sizeof *o.hd);
+    o.max_damage = malloc(num_threads * sizeof *o.max_damage);
+    for (int i = 0; i < N; i++) {
+        o.h[i] = H[i], o.d[i] = D[i];
+        o.hd[i] = o.h[i] * o.d[i];
+    };
+
+    parallel_run(num_threads, oracle_worker, &o);
+
+    for (int t = 0; t < num_threads; t++)
+        max_damage = MAX(max_damage, o.max_damage[t]);
+
+    free(o.max_damage);
+    free(o.hd);
+    free(o.d);
+    free(o.h);
+
+    return (double)max_damage / B;
+}
+
+
+/*
+ * Dynamic upper envelope of lines.
+ *
+ * The lines are the leaves of a binary search tree ordered by slope.  Every
+ * slope below the right child of a node is at least as large as every slope
+ * below its left child, so the right envelope minus the left envelope is
+ * non-decreasing and there is a single point from which on the right child
+ * wins.  Each internal node stores that crossing point, which makes the
+ * envelope at x a single descent from the root, and searches for it again
+ * in [ENVELOPE_XMIN, ENVELOPE_XMAX] whenever a subtree changes.
+ *
+ * The tree is kept balanced as a scapegoat tree: the highest subtree on an
+ * insertion path that has become too lopsided is rebuilt from scratch, and
+ * so is the whole tree once half of its lines are gone.  Insertions and
+ * removals take O(log^2 N log X) amortized time and queries O(log N).
+ */
+
+#define ENVELOPE_XMIN   1
+#define ENVELOPE_XMAX   1000000000
+#define ENVELOPE_ALPHA  0.75
+#define ENVELOPE_DEPTH  128
+
+#define IS_LEAF(n)      ( (n)->left < 0 )
+
+
+typedef struct env_node {
+    int left, right;                // children, or -1 for a leaf
+    int size;                       // number of leaves below
+    int id;                         // leaf: the line's id
+    line_t line;                    // leaf: the line; internal: separator
+    int sep_id;                     // internal: id of the separator
+    long long cross;                // internal: where the right child wins
+} env_node_t;
+
+
+typedef struct envelope {
+    int root, max_size;
+    int num_nodes, max_nodes;       // node pool
+    int free_node;                  // first node of the free list
+    env_node_t *node;               // [max_nodes]
+    int *leaf, num_leaves;          // scratch space for rebuilds
+} envelope_t;
+
+
+envelope_t *envelope_new(void) {
+    envelope_t *e = calloc(1, sizeof *e);
+
+    e->root = -1;
+    e->free_node = -1;
+
+    return e;
+}
+
+
+void envelope_delete(envelope_t *e) {
+    if (!e)
+        return;
+
+    free(e->leaf);
+    free(e->node);
+    free(e);
+}
+
+
+int env_alloc(envelope_t *e) {
+    int n = e->free_node;
+
+    if (n >= 0) {
+        e->free_node = e->node[n].left;
+    } else {
+        if (e->num_nodes == e->max_nodes) {
+            e->max_nodes = 2*e->max_nodes + 16;
+            e->node = realloc(e->node, e->max_nodes * sizeof *e->node);
+        };
+        n = e->num_nodes++;
+    };
+
+    return n;
+}
+
+
+void env_free(envelope_t *e, int n) {
+    e->node[n].left = e->free_node;
+    e->free_node = n;
+}
+
+
+/*
+ * Order lines by slope, then intercept, then id.
+ */
+int env_key_le(line_t l, int id, line_t m, int m_id) {
+    if (l.a != m.a)
+        return l.a < m.a;
+    if (l.b != m.b)
+        return l.b < m.b;
+    return id <= m_id;
+}
+
+
+long long env_eval(envelope_t *e, int n, long long x, int *id) {
+    while (!IS_LEAF(&e->node[n]))
+        n = x >= e->node[n].cross ? e->node[n].right : e->node[n].left;
+
+    if (id)
+        *id = e->node[n].id;
+
+    return LINE_AT(e->node[n].line, x);
+}
+
+
+int env_right_wins(envelope_t *e, env_node_t *v, long long x) {
+    return env_eval(e, v->right, x, NULL) >= env_eval(e, v->left, x, NULL);
+}
+
+
+/*
+ * Recompute size and crossing point of internal node n.  With hint set the
+ * search starts from the old crossing point, which usually moves only a
+ * little when a single line is added or removed below.
+ */
+void env_update(envelope_t *e, int n, int hint) {
+    env_node_t *v = &e->node[n];
+    long long lo = ENVELOPE_XMIN, hi = ENVELOPE_XMAX+1;
+
+    v->size = e->node[v->left].size + e->node[v->right].size;
+
+    // narrow down [lo,hi] by galloping away from the old crossing point
+    if (hint && v->cross >= lo && v->cross <= ENVELOPE_XMAX) {
+        long long x = v->cross, step = 1;
+
+        if (env_right_wins(e, v, x)) {
+            hi = x;
+            while (hi - step >= lo && env_right_wins(e, v, hi - step))
+                hi -= step, step *= 2;
+            if (hi - step >= lo)
+                lo = hi - step + 1;
+        } else {
+            lo = x + 1;
+            while (lo + step-1 <= ENVELOPE_XMAX && !env_right_wins(e, v, lo + step-1))
+                lo += step, step *= 2;
+            if (lo + step-1 <= ENVELOPE_XMAX)
+                hi = lo + step-1;
+        };
+    };
+
+    while (lo < hi) {
+        long long mid = lo + (hi-lo) / 2;
+        if (env_right_wins(e, v, mid))
+            hi = mid;
+        else
+            lo = mid+1;
+    };
+    v->cross = lo;
+}
+
+
+void env_collect(envelope_t *e, int n) {
+    if (IS_LEAF(&e->node[n])) {
+        e->leaf[e->num_leaves++] = n;
+        return;
+    };
+
+    env_collect(e, e->node[n].left);
+    env_collect(e, e->node[n].right);
+    env_free(e, n);
+}
+
+
+int env_build(envelope_t *e, int *leaf, int n) {
+    if (n == 1)
+        return leaf[0];
+
+    int u = env_alloc(e);
+    int left = env_build(e, leaf, n/2);
+    int right = env_build(e, leaf + n/2, n - n/2);
+
+    e->node[u].left = left;
+    e->node[u].right = right;
+    e->node[u].line = e->node[leaf[n/2-1]].line;
+    e->node[u].sep_id = e->node[leaf[n/2-1]].id;
+    env_update(e, u, 0);
+
+    return u;
+}
+
+
+/*
+ * Rebuild the subtree rooted at node n perfectly balanced and return its new
+ * root.
+ */
+int env_rebuild(envelope_t *e, int n) {
+    e->leaf = realloc(e->leaf, e->node[n].size * sizeof *e->leaf);
+    e->num_leaves = 0;
+    env_collect(e, n);
+
+    return env_build(e, e->leaf, e->num_leaves);
+}
+
+
+void envelope_insert(envelope_t *e, line_t l, int id) {
+    int path[ENVELOPE_DEPTH], depth = 0;
+    int leaf = env_alloc(e), n;
+
+    e->node[leaf] = (env_node_t){ .left = -1, .right = -1, .size = 1,
+        .id = id, .line = l };
+
+    if (e->root < 0) {
+        e->root = leaf;
+        e->max_size = 1;
+        return;
+    };
+
+    for (n = e->root; !IS_LEAF(&e->node[n]); ) {
+        path[depth++] = n;
+        if (env_key_le(l, id, e->node[n].line, e->node[n].sep_id))
+            n = e->node[n].left;
+        else
+            n = e->node[n].right;
+    };
+
+    // replace leaf n by an internal node with children n and the new leaf
+    int u = env_alloc(e);
+    if (env_key_le(l, id, e->node[n].line, e->node[n].id)) {
+        e->node[u] = (env_node_t){ .left = leaf, .right = n,
+            .line = l, .sep_id = id };
+    } else {
+        e->node[u] = (env_node_t){ .left = n, .right = leaf,
+            .line = e->node[n].line, .sep_id = e->node[n].id };
+    };
+
+    if (depth == 0)
+        e->root = u;
+    else if (e->node[path[depth-1]].left == n)
+        e->node[path[depth-1]].left = u;
+    else
+        e->node[path[depth-1]].right = u;
+    path[depth++] = u;
+
+    // find the highest node which has become unbalanced
+    int goat = -1;
+    for (int k = depth-1; k >= 0; k--) {
+        env_node_t *v = &e->node[path[k]];
+        v->size = e->node[v->left].size + e->node[v->right].size;
+        if (e->node[v->left].size > ENVELOPE_ALPHA * v->size ||
+            e->node[v->right].size > ENVELOPE_ALPHA * v->size)
+        {
+            goat = k;
+        };
+    };
+
+    if (goat >= 0) {
+        int r = env_rebuild(e, path[goat]);
+        if (goat == 0)
+            e->root = r;
+        else if (e->node[path[goat-1]].left == path[goat])
+            e->node[path[goat-1]].left = r;
+        else
+            e->node[path[goat-1]].right = r;
+        depth = goat;
+    };
+
+    for (int k = depth-1; k >= 0; k--)
+        env_update(e, path[k], 1);
+
+    if (e->node[e->root].size > e->max_size)
+        e->max_size = e->node[e->root].size;
+}
+
+
+void envelope_remove(envelope_t *e, line_t l, int id) {
+    int path[ENVELOPE_DEPTH], depth = 0;
+    int n;
+
+    for (n = e->root; !IS_LEAF(&e->node[n]); ) {
+        path[depth++] = n;
+        if (env_key_le(l, id, e->node[n].line, e->node[n].sep_id))
+            n = e->node[n].left;
+        else
+            n = e->node[n].right;
+    };
+    env_free(e, n);
+
+    if (depth == 0) {
+        e->root = -1;
+        return;
+    };
+
+    // replace the parent by the sibling
+    int p = path[--depth];
+    int sibling = e->node[p].left == n ? e->node[p].right : e->node[p].left;
+    if (depth == 0)
+        e->root = sibling;
+    else if (e->node[path[depth-1]].left == p)
+        e->node[path[depth-1]].left = sibling;
+    else
+        e->node[path[depth-1]].right = sibling;
+    env_free(e, p);
+
+    for (int k = depth-1; k >= 0; k--)
+        env_update(e, path[k], 1);
+
+    if (2 * e->node[e->root].size < e->max_size) {
+        if (!IS_LEAF(&e->node[e->root]))
+            e->root = env_rebuild(e, e->root);
+        e->max_size = e->node[e->root].size;
+    };
+}
+
+
+/*
+ * Maximum of all lines at x, or LLONG_MIN if there are none.  The id of a
+ * maximal line is stored in *id, or -1.
+ */
+long long envelope_max(envelope_t *e, long long x, int *id) {
+    if (e->root < 0) {
+        *id = -1;
+        return LLONG_MIN;
+    };
+
+    return env_eval(e, e->root, x, id);
+}
+
+
+/*
+ * Maximum at x of all lines but line l with the given id, which must be in
+ * the envelope, or LLONG_MIN if there are none.  The subtrees hanging off
+ * the path to l cover all the other lines, so this is O(log^2 N).
+ */
+long long envelope_max_except(envelope_t *e, long long x, line_t l, int id, int *best_id) {
+    long long best = LLONG_MIN, v;
+    int n = e->root, other_id;
+
+    *best_id = -1;
+    while (n >= 0 && !IS_LEAF(&e->node[n])) {
+        env_node_t *u = &e->node[n];
+        int left = env_key_le(l, id, u->line, u->sep_id);
+
+        v = env_eval(e, left ? u->right : u->left, x, &other_id);
+        if (v > best)
+            best = v, *best_id = other_id;
+        n = left ? u->left : u->right;
+    };
+
+    return best;
+}
+
+
+int env_leaf_cmp(const void *x, const void *y) {
+    const env_node_t *u = x, *v = y;
+
+    if (u->line.a != v->line.a)
+        return u->line.a < v->line.a ? -1 : 1;
+    if (u->line.b != v->line.b)
+        return u->line.b < v->line.b ? -1 : 1;
+    return (u->id > v->id) - (u->id < v->id);
+}
+
+
+/*
+ * Replace all lines by the n leaves given, which are sorted in place, and
+ * build the tree over them balanced in O(N log N log X).
+ */
+void envelope_assign(envelope_t *e, env_node_t *leaf, int n) {
+    qsort(leaf, n, sizeof *leaf, env_leaf_cmp);
+
+    e->num_nodes = 0;
+    e->free_node = -1;
+    e->root = -1;
+    e->max_size = n;
+    if (n == 0)
+        return;
+
+    if (e->max_nodes < 2*n) {
+        e->max_nodes = 2*n;
+        e->node = realloc(e->node, e->max_nodes * sizeof *e->node);
+    };
+    e->leaf = realloc(e->leaf, n * sizeof *e->leaf);
+    for (int i = 0; i < n; i++) {
+        e->node[i] = leaf[i];
+        e->leaf[i] = env_alloc(e);
+    };
+
+    e->root = env_build(e, e->leaf, n);
+}
+
+
+/*
+ * Warrior roster with incremental best-pair queries.
+ *
+ * Every warrior w knows its best partner in either role: the best front line
+ * warrior to back up (the envelope of the lines l_i above at D[w]) and the
+ * best backup (the envelope of the lines m_j(x) = D[j]*x + H[j]*D[j] at
+ * H[w]).  Both pairs go into a max-heap, tagged with w's version so they can
+ * be discarded lazily once w leaves or recomputes its partners.
+ *
+ * A newly inserted warrior computes its partners against everyone present,
+ * and so covers every pair it forms with earlier warriors.  When a warrior
+ * leaves, exactly those warriors whose best partner it was recompute theirs.
+ * Every pair of present warriors is therefore dominated by a valid heap
+ * entry, and the top valid entry is the answer.
+ *
+ * Each recomputation is O(log^2 N log X) and answering is amortized
+ * O(log N).  A removal pays one recomputation for every warrior which had the
+ * removed one as its best partner, up to one in ROSTER_REPAIR of the warriors
+ * present.  Past that, as when a warrior who was the best partner of nearly
+ * everyone leaves, the envelopes are built anew from all warriors in
+ * O(N log N log X) and every warrior finds its best partner among all others
+ * with one query each, instead of the three removals and insertions per
+ * warrior of repairing them one by one.
+ */
+
+#define ROSTER_REPAIR   16
+
+typedef struct roster_pair {
+    long long damage;               // times B
+    int owner, version;
+} roster_pair_t;
+
+
+typedef struct roster_warrior {
+    long long h, d;
+    int alive, version;
+    int next_free;                  // next unused id
+    int partner[2];                 // best front line warrior, best backup
+    long long damage[2];            // damage times B dealt with them
+    int *dependent;                 // warriors who may have this as partner
+    int num_dependents, max_dependents;
+} roster_warrior_t;
+
+
+typedef struct roster {
+    int size;                       // number of warriors present
+    int num_warriors, max_warriors, free_warrior;
+    roster_warrior_t *warrior;      // [max_warriors]
+    int *mark, stamp;               // [max_warriors] scratch for dedup
+    envelope_t *front, *back;       // lines l_i and m_j
+    int heap_size, max_heap;
+    roster_pair_t *heap;            // [max_heap]
+} roster_t;
+
+
+roster_t *roster_new(void) {
+    roster_t *r = calloc(1, sizeof *r);
+
+    r->free_warrior = -1;
+    r->front = envelope_new();
+    r->back = envelope_new();
+
+    return r;
+}
+
+
+void roster_delete(roster_t *r) {
+    if (!r)
+        return;
+
+    for (int i = 0; i < r->max_warriors; i++)
+        free(r->warrior[i].dependent);
+    free(r->warrior);
+    free(r->mark);
+    envelope_delete(r->front);
+    envelope_delete(r->back);
+    free(r->heap);
+    free(r);
+}
+
+
+void roster_heap_push(roster_t *r, roster_pair_t p) {
+    int i;
+
+    if (r->heap_size == r->max_heap) {
+        r->max_heap = 2*r->max_heap + 16;
+        r->heap = realloc(r->heap, r->max_heap * sizeof *r->heap);
+    };
+
+    for (i = r->heap_size++; i > 0 && r->heap[(i-1)/2].damage < p.damage; i = (i-1)/2)
+        r->heap[i] = r->heap[(i-1)/2];
+    r->heap[i] = p;
+}
+
+
+void roster_heap_pop(roster_t *r) {
+    roster_pair_t p = r->heap[--r->heap_size];
+    int i = 0, c;
+
+    while ((c = 2*i+1) < r->heap_size) {
+        if (c+1 < r->heap_size && r->heap[c+1].damage > r->heap[c].damage)
+            c++;
+        if (r->heap[c].damage <= p.damage)
+            break;
+        r->heap[i] = r->heap[c];
+        i = c;
+    };
+    r->heap[i] = p;
+}
+
+
+int roster_pair_valid(roster_t *r, roster_pair_t *p) {
+    return r->warrior[p->owner].alive && r->warrior[p->owner].version == p->version;
+}
+
+
+/*
+ * Register warrior w as depending on warrior p.  Stale and duplicate entries
+ * are dropped before the list is grown.
+ */
+void roster_add_dependent(roster_t *r, int p, int w) {
+    roster_warrior_t *x = &r->warrior[p];
+
+    if (x->num_dependents == x->max_dependents) {
+        int n = 0;
+
+        r->stamp++;
+        for (int k = 0; k < x->num_dependents; k++) {
+            int o = x->dependent[k];
+            roster_warrior_t *y = &r->warrior[o];
+            if (y->alive && (y->partner[0] == p || y->partner[1] == p) &&
+                r->mark[o] != r->stamp)
+            {
+                r->mark[o] = r->stamp;
+                x->dependent[n++] = o;
+            };
+        };
+        x->num_dependents = n;
+
+        if (2*n >= x->max_dependents) {
+            x->max_dependents = 2*x->max_dependents + 4;
+            x->dependent = realloc(x->dependent,
+                x->max_dependents * sizeof *x->dependent);
+        };
+    };
+
+    x->dependent[x->num_dependents++] = w;
 }
 
 
+/*
+ * Find the best partners of warrior w among the others in the envelopes,
+ * where linked says whether w is in them itself.
+ */
+void roster_update(roster_t *r, int w, int linked) {
+    roster_warrior_t *x = &r->warrior[w];
+    long long hd = x->h * x->d, v;
+
+    x->version++;
+
+    // w itself is rarely the maximum, and only then is it searched around
+    v = envelope_max(r->front, x->d, &x->partner[0]);
+    if (linked && x->partner[0] == w)
+        v = envelope_max_except(r->front, x->d, (line_t){ x->h, hd }, w, &x->partner[0]);
+    x->damage[0] = v == LLONG_MIN ? v : v + hd;
+    v = envelope_max(r->back, x->h, &x->partner[1]);
+    if (linked && x->partner[1] == w)
+        v = envelope_max_except(r->back, x->h, (line_t){ x->d, hd }, w, &x->partner[1]);
+    x->damage[1] = v == LLONG_MIN ? v : v + hd;
+
+    for (int k = 0; k < 2; k++) {
+        if (x->partner[k] < 0)
+            continue;
+        roster_heap_push(r, (roster_pair_t){ x->damage[k], w, x->version });
+        roster_add_dependent(r, x->partner[k], w);
+    };
+}
+
+
+void roster_link(roster_t *r, int w) {
+    roster_warrior_t *x = &r->warrior[w];
+
+    envelope_insert(r->front, (line_t){ x->h, x->h * x->d }, w);
+    envelope_insert(r->back, (line_t){ x->d, x->h * x->d }, w);
+}
+
+
+void roster_unlink(roster_t *r, int w) {
+    roster_warrior_t *x = &r->warrior[w];
+
+    envelope_remove(r->front, (line_t){ x->h, x->h * x->d }, w);
+    envelope_remove(r->back, (line_t){ x->d, x->h * x->d }, w);
+}
+
+
+/*
+ * Add a warrior with health H and damage per second D and return its id.
+ */
+int roster_insert(roster_t *r, int H, int D) {
+    int w = r->free_warrior;
+
+    if (w >= 0) {
+        r->free_warrior = r->warrior[w].next_free;
+    } else {
+        if (r->num_warriors == r->max_warriors) {
+            r->max_warriors = 2*r->max_warriors + 16;
+            r->warrior = realloc(r->warrior, r->max_warriors * sizeof *r->warrior);
+            r->mark = realloc(r->mark, r->max_warriors * sizeof *r->mark);
+            for (int i = r->num_warriors; i < r->max_warriors; i++) {
+                r->warrior[i] = (roster_warrior_t){ 0 };
+                r->mark[i] = 0;
+            };
+        };
+        w = r->num_warriors++;
+    };
+
+    r->warrior[w].h = H;
+    r->warrior[w].d = D;
+    r->warrior[w].alive = 1;
+    r->warrior[w].num_dependents = 0;
+    r->size++;
+
+    roster_update(r, w, 0);
+    roster_link(r, w);
+
+    // keep stale heap entries from piling up
+    if (r->heap_size > 4 * r->size + 64) {
+        int n = 0;
+        for (int i = 0; i < r->heap_size; i++)
+            if (roster_pair_valid(r, &r->heap[i]))
+                r->heap[n++] = r->heap[i];
+        r->heap_size = 0;
+        for (int i = 0; i < n; i++)
+            roster_heap_push(r, r->heap[i]);
+    };
+
+    return w;
+}
+
+
+/*
+ * Build the envelopes anew from the warriors present and find the best
+ * partners of every one of them among all others.
+ */
+void roster_rebuild(roster_t *r) {
+    env_node_t *front = malloc(r->size * sizeof *front);
+    env_node_t *back = malloc(r->size * sizeof *back);
+    int n = 0;
+
+    for (int w = 0; w < r->num_warriors; w++) {
+        roster_warrior_t *x = &r->warrior[w];
+
+        if (!x->alive)
+            continue;
+        front[n] = (env_node_t){ .left = -1, .right = -1, .size = 1,
+            .id = w, .line = { x->h, x->h * x->d } };
+        back[n] = (env_node_t){ .left = -1, .right = -1, .size = 1,
+            .id = w, .line = { x->d, x->h * x->d } };
+        x->num_dependents = 0;
+        n++;
+    };
+    envelope_assign(r->front, front, n);
+    envelope_assign(r->back, back, n);
+    free(back);
+    free(front);
+
+    r->heap_size = 0;
+    for (int w = 0; w < r->num_warriors; w++)
+        if (r->warrior[w].alive)
+            roster_update(r, w, 1);
+}
+
+
+/*
+ * Retire the warrior with the given id.
+ */
+void roster_remove(roster_t *r, int w) {
+    roster_warrior_t *x = &r->warrior[w];
+    int repairs = 0;
+
+    roster_unlink(r, w);
+    x->alive = 0;
+    x->version++;
+    r->size--;
+
+    r->stamp++;
+    for (int k = 0; k < x->num_dependents; k++) {
+        int o = x->dependent[k];
+        roster_warrior_t *y = &r->warrior[o];
+
+        if (y->alive && (y->partner[0] == w || y->partner[1] == w) && r->mark[o] != r->stamp)
+            r->mark[o] = r->stamp, repairs++;
+    };
+
+    if (repairs * ROSTER_REPAIR > r->size) {
+        roster_rebuild(r);
+    } else {
+        for (int k = 0; k < x->num_dependents; k++) {
+            int o = x->dependent[k];
+            roster_warrior_t *y = &r->warrior[o];
+
+            if (!y->alive || (y->partner[0] != w && y->partner[1] != w))
+                continue;
+
+            roster_unlink(r, o);
+            roster_update(r, o, 0);
+            roster_link(r, o);
+        };
+    };
+
+    x->num_dependents = 0;
+    x->next_free = r->free_warrior;
+    r->free_warrior = w;
+}
+
+
+/*
+ * Maximum damage any two warriors currently on the roster can deal to a boss
+ * dealing B damage per second, or 0 if there are fewer than two.
+ */
+double roster_max_damage(roster_t *r, int B) {
+    while (r->heap_size > 0 && !roster_pair_valid(r, &r->heap[0]))
+        roster_heap_pop(r);
+
+    return r->heap_size > 0 ? (double)r->heap[0].damage / B : 0.0;
+}
+
+
+#ifndef BENCH
+
 int main (int argc, char **argv) {
     printf("result = %f, expected = %f\n",
         getMaxDamageDealt(3, (int []){2,1,4}, (int []){3,1,2}, 4), 6.5);
@@ -64,5 +1106,139 @@ int main (int argc, char **argv) {
         getMaxDamageDealt(4, (int []){1,1,2,100}, (int []){1,2,1,3}, 8), 62.75);
     printf("result = %f, expected = %f\n",
         getMaxDamageDealt(4, (int []){1,1,2,3}, (int []){1,2,1,100}, 8), 62.75);
+    printf("result = %f, expected = %f\n",
+        getMaxDamageDealt(2, (int []){1000000000,1000000000},
+            (int []){1000000000,1000000000}, 1), 3e18);
+
+    // compare against the pairwise solution on random warriors
+    int H[1000], D[1000];
+    srand(1);
+    for (int i = 0; i < 1000; i++)
+        H[i] = rand() % 1000000000 + 1, D[i] = rand() % 1000000000 + 1;
+    printf("result = %f, expected = %f\n",
+        getMaxDamageDealt(1000, H, D, 1000), getMaxDamageDealtPairwise(1000, H, D, 1000));
+    printf("result = %f, expected = %f\n",
+        getMaxDamageDealtOracle(1000, H, D, 1000, 0), getMaxDamageDealtPairwise(1000, H, D, 1000));
+
+    // add and retire warriors at random, comparing against the pairwise
+    // solution on whoever is left
+    roster_t *r = roster_new();
+    int id[5000], h[5000], d[5000], n = 0;
+    for (int step = 1; step <= 5000; step++) {
+        if (n < 2 || rand() % 3) {
+            h[n] = rand() % 1000 + 1, d[n] = rand() % 1000 + 1;
+            id[n] = roster_insert(r, h[n], d[n]);
+            n++;
+        } else {
+            int k = rand() % n;
+            roster_remove(r, id[k]);
+            n--;
+            id[k] = id[n], h[k] = h[n], d[k] = d[n];
+        };
+        if (step % 1000 == 0)
+            printf("result = %f, expected = %f\n",
+                roster_max_damage(r, 3), getMaxDamageDealtPairwise(n, h, d, 3));
+    };
+    roster_delete(r);
+
+    // a warrior who is everyone's best partner, retired first and then in
+    // the middle of the roster, which rebuilds it
+    r = roster_new();
+    n = 0;
+    for (int k = 0; k < 3; k++) {
+        h[n] = d[n] = 1000000, id[n] = roster_insert(r, h[n], d[n]), n++;
+        for (int i = 0; i < 500; i++)
+            h[n] = rand() % 1000 + 1, d[n] = rand() % 1000 + 1, id[n] = roster_insert(r, h[n], d[n]), n++;
+    };
+    for (int k = 2; k >= 0; k--) {
+        roster_remove(r, id[501*k]);
+        n--;
+        id[501*k] = id[n], h[501*k] = h[n], d[501*k] = d[n];
+        printf("result = %f, expected = %f\n",
+            roster_max_damage(r, 3), getMaxDamageDealtPairwise(n, h, d, 3));
+    };
+    for (int i = 0; i < 1000; i++) {
+        int k = rand() % n;
+        roster_remove(r, id[k]);
+        n--;
+        id[k] = id[n], h[k] = h[n], d[k] = d[n];
+    };
+    printf("result = %f, expected = %f\n",
+        roster_max_damage(r, 3), getMaxDamageDealtPairwise(n, h, d, 3));
+    roster_delete(r);
+}
+
+#else
+
+/*
+ * Fill the roster with N warriors from H and D, recording their ids.
+ */
+double roster_fill(roster_t *r, int N, int *H, int *D, int *id) {
+    for (int i = 0; i < N; i++)
+        id[i] = roster_insert(r, H[i], D[i]);
+
+    return roster_max_damage(r, 1000000000);
+}
+
+
+/*
+ * Replace random warriors by new random ones, querying after each change.
+ */
+double roster_churn(roster_t *r, int N, int *id, int ops) {
+    double damage = 0.0;
+
+    for (int k = 0; k < ops; k++) {
+        int i = bench_range(0, N-1);
+        roster_remove(r, id[i]);
+        id[i] = roster_insert(r, bench_range(1, 1000000000), bench_range(1, 1000000000));
+        damage = roster_max_damage(r, 1000000000);
+    };
+
+    return damage;
+}
+
+
+int main(int argc, char **argv) {
+    int N = 500000;
+    int *H = malloc(N * sizeof *H), *D = malloc(N * sizeof *D);
+    int *id = malloc(N * sizeof *id);
+    roster_t *r;
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        H[i] = bench_range(1, 1000000000), D[i] = bench_range(1, 1000000000);
+    BENCH_CASE("random", N, 3, , getMaxDamageDealt(N, H, D, 1000000000));
+
+    // the pairwise references are quadratic, so stay well below the limit
+    BENCH_CASE("pairwise", 20000, 3, , getMaxDamageDealtPairwise(20000, H, D, 1000000000));
+    BENCH_CASE("oracle", 100000, 1, , getMaxDamageDealtOracle(100000, H, D, 1000000000, 0));
+
+    // a roster of 100,000 warriors, built and then changed one at a time
+    r = roster_new();
+    BENCH_CASE("roster-insert", 100000, 1, , roster_fill(r, 100000, H, D, id));
+    BENCH_CASE("roster-churn", 10000, 3, , roster_churn(r, 100000, id, 10000));
+
+    // the best partner of every other warrior, inserted first and retired
+    H[0] = D[0] = 1000000000;
+    BENCH_CASE("roster-remove-dominant", 100000, 3,
+        (roster_delete(r), r = roster_new(), roster_fill(r, 100000, H, D, id)),
+        (roster_remove(r, id[0]), roster_max_damage(r, 1000000000)));
+    roster_delete(r);
+
+    bench_seed(2);
+    for (int i = 0; i < N; i++)
+        H[i] = 1000000000, D[i] = 1000000000;
+    BENCH_CASE("max", N, 3, , getMaxDamageDealt(N, H, D, 1));
+
+    // health and damage per second in opposite orders
+    bench_seed(0);
+    for (int i = 0; i < N; i++)
+        H[i] = 1 + 2000*i, D[i] = 1000000000 - 2000*i;
+    BENCH_CASE("antisorted", N, 3, , getMaxDamageDealt(N, H, D, 1));
+
+    free(id);
+    free(D);
+    free(H);
 }
 
+#endif
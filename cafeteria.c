@@ -1,16 +1,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "radix-sort.h"
 
-int compare(const void *i, const void *j) {
-    return *(const long long *)i > *(const long long *)j;
-}
+#ifdef BENCH
+#include "bench.h"
+#endif
 
+#define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
+#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
 
-long long getMaxAdditionalDinersCount(long long N, long long K, int M, long long *S) {
+
+/*
+ * Same as getMaxAdditionalDinersCount() with scratch[0..M) as space for
+ * sorting, so callers solving many cases can allocate it once.
+ */
+long long getMaxAdditionalDinersCountScratch(long long N, long long K, int M, long long *S,
+        long long *scratch)
+{
     long long result;
 
-    qsort(S, M, sizeof *S, compare);
+    radix_sort_ll(S, M, scratch);
 
     result = (S[0]-1) / (K+1);
     for (int i = 0; i < M-1; i++)
@@ -21,6 +31,209 @@ long long getMaxAdditionalDinersCount(long long N, long long K, int M, long long
 }
 
 
+long long getMaxAdditionalDinersCount(long long N, long long K, int M, long long *S) {
+    long long *scratch = malloc(M * sizeof *scratch);
+    long long result = getMaxAdditionalDinersCountScratch(N, K, M, S, scratch);
+
+    free(scratch);
+    return result;
+}
+
+
+/*
+ * Live seating index.
+ *
+ * The occupied seats are kept in a treap, so the nearest occupied seats on
+ * either side of any seat are found in O(log M).  The number of additional
+ * diners is a sum over the gaps between neighbouring occupied seats, where
+ * the ends of the table count as virtual diners in seats -K and N+K+1, so
+ * occupying a seat only replaces the gap it splits by the two new ones and
+ * vacating a seat does the reverse.  Both are O(log M) expected, and the
+ * current total is always available in O(1).
+ */
+
+typedef struct seat_node {
+    long long seat;
+    unsigned priority;
+    int left, right;                // child nodes, -1 if none
+} seat_node_t;
+
+
+typedef struct seating {
+    long long N, K;
+    long long count;                // maximum number of additional diners
+    int size;                       // number of occupied seats
+    int root;
+    int num_nodes, max_nodes, free_node;
+    seat_node_t *node;              // [max_nodes]
+    unsigned random;
+} seating_t;
+
+
+// additional diners fitting strictly between diners in seats a < b
+static long long seating_gap(long long K, long long a, long long b) {
+    return b-1 - (a+K) > 0 ? (b-1 - (a+K)) / (K+1) : 0;
+}
+
+
+seating_t *seating_new(long long N, long long K) {
+    seating_t *s = calloc(1, sizeof *s);
+
+    s->N = N;
+    s->K = K;
+    s->root = s->free_node = -1;
+    s->random = 2463534242u;
+    s->count = seating_gap(K, -K, N+K+1);
+
+    return s;
+}
+
+
+void seating_delete(seating_t *s) {
+    if (!s)
+        return;
+
+    free(s->node);
+    free(s);
+}
+
+
+/*
+ * Split the subtree t into the seats < seat and those >= seat.
+ */
+static void seating_split(seating_t *s, int t, long long seat, int *lo, int *hi) {
+    if (t < 0) {
+        *lo = *hi = -1;
+    } else if (s->node[t].seat < seat) {
+        seating_split(s, s->node[t].right, seat, &s->node[t].right, hi);
+        *lo = t;
+    } else {
+        seating_split(s, s->node[t].left, seat, lo, &s->node[t].left);
+        *hi = t;
+    };
+}
+
+
+/*
+ * Join the subtrees lo and hi, all of whose seats are smaller in lo.
+ */
+static int seating_merge(seating_t *s, int lo, int hi) {
+    if (lo < 0)
+        return hi;
+    if (hi < 0)
+        return lo;
+
+    if (s->node[lo].priority > s->node[hi].priority) {
+        s->node[lo].right = seating_merge(s, s->node[lo].right, hi);
+        return lo;
+    } else {
+        s->node[hi].left = seating_merge(s, lo, s->node[hi].left);
+        return hi;
+    };
+}
+
+
+/*
+ * Nearest occupied seats strictly below and strictly above seat, or the
+ * virtual diners at the ends of the table if there are none.  Returns
+ * whether seat itself is occupied.
+ */
+static int seating_neighbours(seating_t *s, long long seat, long long *below, long long *above) {
+    int t = s->root;
+
+    *below = -s->K;
+    *above = s->N + s->K + 1;
+
+    while (t >= 0 && s->node[t].seat != seat)
+        if (s->node[t].seat < seat)
+            *below = s->node[t].seat, t = s->node[t].right;
+        else
+            *above = s->node[t].seat, t = s->node[t].left;
+
+    if (t < 0)
+        return 0;
+
+    for (int u = s->node[t].left; u >= 0; u = s->node[u].right)
+        *below = s->node[u].seat;
+    for (int u = s->node[t].right; u >= 0; u = s->node[u].left)
+        *above = s->node[u].seat;
+
+    return 1;
+}
+
+
+/*
+ * Seat a diner in seat 1 <= seat <= N.  Returns 0 if it was already taken.
+ */
+int seating_occupy(seating_t *s, long long seat) {
+    long long below, above;
+    int lo, hi, t;
+
+    if (seating_neighbours(s, seat, &below, &above))
+        return 0;
+
+    s->count += seating_gap(s->K, below, seat) + seating_gap(s->K, seat, above)
+        - seating_gap(s->K, below, above);
+
+    if (s->free_node >= 0) {
+        t = s->free_node;
+        s->free_node = s->node[t].left;
+    } else {
+        if (s->num_nodes == s->max_nodes) {
+            s->max_nodes = 2*s->max_nodes + 16;
+            s->node = realloc(s->node, s->max_nodes * sizeof *s->node);
+        };
+        t = s->num_nodes++;
+    };
+
+    // xorshift32 priorities
+    s->random ^= s->random << 13;
+    s->random ^= s->random >> 17;
+    s->random ^= s->random << 5;
+    s->node[t] = (seat_node_t){ seat, s->random, -1, -1 };
+
+    seating_split(s, s->root, seat, &lo, &hi);
+    s->root = seating_merge(s, seating_merge(s, lo, t), hi);
+    s->size++;
+
+    return 1;
+}
+
+
+/*
+ * Free seat 1 <= seat <= N.  Returns 0 if it was not taken.
+ */
+int seating_vacate(seating_t *s, long long seat) {
+    long long below, above;
+    int lo, mid, hi;
+
+    if (!seating_neighbours(s, seat, &below, &above))
+        return 0;
+
+    s->count += seating_gap(s->K, below, above)
+        - seating_gap(s->K, below, seat) - seating_gap(s->K, seat, above);
+
+    seating_split(s, s->root, seat, &lo, &hi);
+    seating_split(s, hi, seat+1, &mid, &hi);
+    s->root = seating_merge(s, lo, hi);
+    s->size--;
+
+    s->node[mid].left = s->free_node;
+    s->free_node = mid;
+
+    return 1;
+}
+
+
+/*
+ * Maximum number of additional diners for the seats currently occupied.
+ */
+long long seating_count(seating_t *s) {
+    return s->count;
+}
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     long long S1[] = { 2, 6 };
     long long S2[] = { 11, 6, 14 };
@@ -28,6 +241,149 @@ int main(int argc, char **argv) {
     printf("%lld\n", getMaxAdditionalDinersCount(10, 1, 2, S1));
     printf("%lld\n", getMaxAdditionalDinersCount(15, 2, 3, S2));
 
+    seating_t *s = seating_new(15, 2);
+    seating_occupy(s, 11), seating_occupy(s, 6), seating_occupy(s, 14);
+    printf("result = %lld, expected = %lld\n", seating_count(s), 1LL);
+    seating_vacate(s, 6);
+    printf("result = %lld, expected = %lld\n", seating_count(s), 3LL);
+    seating_vacate(s, 11), seating_vacate(s, 14);
+    printf("result = %lld, expected = %lld\n", seating_count(s), 5LL);
+    seating_delete(s);
+
+    // seat and unseat diners at random, comparing against a full recount
+    long long S[100];
+    int taken[101] = { 0 }, M = 0;
+    srand(1);
+    s = seating_new(100, 3);
+    for (int step = 1; step <= 5000; step++) {
+        long long seat = rand() % 100 + 1;
+        int free = 1;
+
+        for (long long i = MAX(1, seat-3); i <= MIN(100, seat+3); i++)
+            free &= !taken[i] || i == seat;
+        if (taken[seat])
+            seating_vacate(s, seat), taken[seat] = 0;
+        else if (free)
+            seating_occupy(s, seat), taken[seat] = 1;
+
+        if (step % 1000 == 0) {
+            M = 0;
+            for (int i = 1; i <= 100; i++)
+                if (taken[i])
+                    S[M++] = i;
+            printf("result = %lld, expected = %lld\n", seating_count(s),
+                M ? getMaxAdditionalDinersCount(100, 3, M, S) : (100+3) / (3+1));
+        };
+    };
+    seating_delete(s);
+
     return 0;
 }
 
+#else
+
+int ll_cmp(const void *x, const void *y) {
+    long long a = *(const long long *)x, b = *(const long long *)y;
+    return (a > b) - (a < b);
+}
+
+
+/*
+ * Seat the diners S[0..M) one by one into an empty index.
+ */
+long long seatingFill(seating_t *s, int M, long long *S) {
+    for (int i = 0; i < M; i++)
+        seating_occupy(s, S[i]);
+
+    return seating_count(s);
+}
+
+
+/*
+ * Let random diners leave and return, M times, querying after each change.
+ */
+long long seatingChurn(seating_t *s, int M, long long *S) {
+    long long total = 0;
+
+    for (int i = 0; i < M; i++) {
+        long long seat = S[bench_range(0, M-1)];
+
+        seating_vacate(s, seat);
+        total += seating_count(s);
+        seating_occupy(s, seat);
+        total += seating_count(s);
+    };
+
+    return total;
+}
+
+
+long long sortRadix(long long *S, int M, long long *scratch) {
+    radix_sort_ll(S, M, scratch);
+    return S[M/2];
+}
+
+
+long long sortQsort(long long *S, int M) {
+    qsort(S, M, sizeof *S, ll_cmp);
+    return S[M/2];
+}
+
+
+int main(int argc, char **argv) {
+    long long N = 1000000000000000LL, K;
+    int M = 500000;
+    long long *S0 = malloc(M * sizeof *S0), *S = malloc(M * sizeof *S);
+
+    // diners at least K+1 seats apart, as far as N allows
+    bench_seed(1);
+    K = bench_range(1, 1000000);
+    S0[0] = bench_range(1, N/M);
+    for (int i = 1; i < M; i++)
+        S0[i] = S0[i-1] + K+1 + bench_range(0, N/M - K-1);
+    BENCH_CASE("sorted", M, 5, memcpy(S, S0, M * sizeof *S),
+        getMaxAdditionalDinersCount(N, K, M, S));
+
+    for (int i = 0; i < M/2; i++) {
+        long long t = S0[i]; S0[i] = S0[M-1-i], S0[M-1-i] = t;
+    };
+    BENCH_CASE("reversed", M, 5, memcpy(S, S0, M * sizeof *S),
+        getMaxAdditionalDinersCount(N, K, M, S));
+
+    bench_shuffle_ll(S0, M);
+    BENCH_CASE("random", M, 5, memcpy(S, S0, M * sizeof *S),
+        getMaxAdditionalDinersCount(N, K, M, S));
+
+    // the scratch space allocated once for every repetition, as for the sorts
+    long long *scratch = malloc(4*M * sizeof *scratch);
+    BENCH_CASE("random-reuse", M, 5, memcpy(S, S0, M * sizeof *S),
+        getMaxAdditionalDinersCountScratch(N, K, M, S, scratch));
+
+    // the same diners arriving one at a time, then coming and going
+    seating_t *seating = seating_new(N, K);
+    BENCH_CASE("seating-occupy", M, 1, , seatingFill(seating, M, S0));
+    BENCH_CASE("seating-churn", M, 3, bench_seed(3), seatingChurn(seating, M, S0));
+    seating_delete(seating);
+
+    // the sort on its own against qsort, on seats and on arbitrary keys
+    BENCH_CASE("sort-radix", M, 5, memcpy(S, S0, M * sizeof *S),
+        sortRadix(S, M, scratch));
+    BENCH_CASE("sort-qsort", M, 5, memcpy(S, S0, M * sizeof *S),
+        sortQsort(S, M));
+
+    S0 = realloc(S0, 4*M * sizeof *S0);
+    S = realloc(S, 4*M * sizeof *S);
+    bench_seed(2);
+    for (int i = 0; i < 4*M; i++)
+        S0[i] = bench_rand();
+    BENCH_CASE("sort-radix-64bit", 4*M, 5, memcpy(S, S0, 4*M * sizeof *S),
+        sortRadix(S, 4*M, scratch));
+    BENCH_CASE("sort-qsort-64bit", 4*M, 5, memcpy(S, S0, 4*M * sizeof *S),
+        sortQsort(S, 4*M));
+
+    free(scratch);
+    free(S);
+    free(S0);
+}
+
+#endif
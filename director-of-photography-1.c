@@ -34,45 +34,251 @@
  * N = 8, C = ".PBAAP.B", X = 1, Y = 3  ->  result = 3
  */
 
+/*
+ * Solution
+ *
+ * Counting needs no enumeration: an artistic photograph with its actor in
+ * cell j has the photographer X to Y cells to one side of j and the backdrop
+ * X to Y cells to the other side, so with prefix counts of the photographers
+ * and backdrops each actor contributes two products of range counts, for
+ * O(N) overall.
+ *
+ * The photographs themselves are listed by enumerateArtisticPhotographs(),
+ * which fills a caller supplied batch buffer and hands every full batch to a
+ * callback, so listing does no allocation and no I/O of its own.  A
+ * photo_writer_t is such a callback which formats the batches as text or
+ * copies them as binary records into a large buffer, and write(2)s that to a
+ * file descriptor whenever it fills up.
+ */
+
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef BENCH
+#include <fcntl.h>
+#include "bench.h"
+#endif
 
 #define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
 #define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
 
 
 int getArtisticPhotographCount(int N, char *C, int X, int Y) {
+    int P[N+1], B[N+1];             // photographers, backdrops in C[0..i)
     int result = 0;
 
+    P[0] = B[0] = 0;
     for (int i = 0; i < N; i++) {
-        if (C[i] != 'P') continue;
+        P[i+1] = P[i] + (C[i] == 'P');
+        B[i+1] = B[i] + (C[i] == 'B');
+    };
 
-        for (int j = MAX(0,i-Y); j <= i-X; j++) {
-            if (C[j] != 'A') continue;
+    for (int j = 0; j < N; j++) {
+        if (C[j] != 'A') continue;
 
-            for (int k = MAX(0,j-Y); k <= j-X; k++) {
-                if (C[k] != 'B') continue;
+        int lo = MAX(0, j-Y), hi = MAX(0, j-X+1);             // [j-Y, j-X]
+        int LO = MIN(N, j+X), HI = MIN(N, j+Y+1);             // [j+X, j+Y]
 
-                result++;
-                printf("B: %d, A: %d, P: %d\n", k, j, i);
-            };
-        };
+        result += (P[hi] - P[lo]) * (B[HI] - B[LO])
+                + (B[hi] - B[lo]) * (P[HI] - P[LO]);
+    };
+
+    return result;
+}
+
+
+/*
+ * An artistic photograph, by the cells of its photographer, actor, and
+ * backdrop.
+ */
+typedef struct photo {
+    int p, a, b;
+} photo_t;
+
+
+typedef void photo_sink_t(const photo_t *photo, int n, void *arg);
+
+
+/*
+ * List every artistic photograph, storing them in batch[0..batch_size) and
+ * calling sink(batch, n, arg) whenever the batch is full and once more for
+ * the rest.  Returns the number of photographs.
+ */
+long long enumerateArtisticPhotographs(int N, char *C, int X, int Y,
+        photo_t *batch, int batch_size, photo_sink_t *sink, void *arg)
+{
+    long long result = 0;
+    int n = 0;
+
+    for (int j = 0; j < N; j++) {
+        if (C[j] != 'A') continue;
+
+        for (int i = MAX(0,j-Y); i <= j-X; i++) {
+            char left = C[i];
 
-        for (int j = i+X; j <= MIN(i+Y,N-1); j++) {
-            if (C[j] != 'A') continue;
+            if (left != 'P' && left != 'B') continue;
 
             for (int k = j+X; k <= MIN(j+Y,N-1); k++) {
-                if (C[k] != 'B') continue;
+                if (C[k] != ('P' ^ 'B' ^ left)) continue;
 
-                result++;
-                printf("P: %d, A: %d, B: %d\n", i, j, k);
+                batch[n++] = left == 'P' ? (photo_t){ i, j, k } : (photo_t){ k, j, i };
+                if (n == batch_size) {
+                    sink(batch, n, arg);
+                    result += n;
+                    n = 0;
+                };
             };
         };
     };
 
-    return result;
+    if (n > 0)
+        sink(batch, n, arg);
+
+    return result + n;
+}
+
+
+/*
+ * Buffered photograph output, for use as a photo_sink_t.  Text output has one
+ * line per photograph listing its cells from left to right, e.g.
+ * "B: 2, A: 3, P: 5"; binary output is the photo_t records as they are in
+ * memory.
+ */
+
+#define PHOTO_WRITER_BUFFER     (1 << 20)
+
+enum { PHOTO_TEXT, PHOTO_BINARY };
+
+
+typedef struct photo_writer {
+    int fd, format;
+    int len;
+    int error;                      // errno of the first failed write
+    char buffer[PHOTO_WRITER_BUFFER];
+} photo_writer_t;
+
+
+photo_writer_t *photo_writer_new(int fd, int format) {
+    photo_writer_t *w = malloc(sizeof *w);
+
+    w->fd = fd;
+    w->format = format;
+    w->len = 0;
+    w->error = 0;
+
+    return w;
+}
+
+
+/*
+ * Write out the buffer, retrying writes interrupted by a signal.  A write
+ * which makes no progress counts as failed with EIO.
+ */
+void photo_writer_flush(photo_writer_t *w) {
+    for (int done = 0, n; done < w->len; done += n) {
+        n = write(w->fd, w->buffer + done, w->len - done);
+        if (n < 0 && errno == EINTR) {
+            n = 0;
+            continue;
+        };
+        if (n <= 0) {
+            w->error = w->error ? w->error : n < 0 ? errno : EIO;
+            break;
+        };
+    };
+    w->len = 0;
 }
 
 
+/*
+ * Flush and free the writer.  Returns 0, or the errno of the first failed
+ * write.
+ */
+int photo_writer_delete(photo_writer_t *w) {
+    int error;
+
+    if (!w)
+        return 0;
+
+    photo_writer_flush(w);
+    error = w->error;
+    free(w);
+
+    return error;
+}
+
+
+static char *photo_format_cell(char *s, char kind, int cell) {
+    char digits[12];
+    int n = 0;
+
+    *s++ = kind, *s++ = ':', *s++ = ' ';
+    do {
+        digits[n++] = '0' + cell % 10;
+        cell /= 10;
+    } while (cell > 0);
+    while (n > 0)
+        *s++ = digits[--n];
+
+    return s;
+}
+
+
+void photo_writer_sink(const photo_t *photo, int n, void *arg) {
+    photo_writer_t *w = arg;
+
+    if (w->format == PHOTO_BINARY) {
+        for (int done = 0, m; done < n; done += m) {
+            if (w->len + (int)sizeof *photo > PHOTO_WRITER_BUFFER)
+                photo_writer_flush(w);
+            m = MIN(n - done, (PHOTO_WRITER_BUFFER - w->len) / (int)sizeof *photo);
+            memcpy(w->buffer + w->len, photo + done, m * sizeof *photo);
+            w->len += m * sizeof *photo;
+        };
+        return;
+    };
+
+    for (int i = 0; i < n; i++) {
+        const photo_t *f = &photo[i];
+        char *s;
+
+        // three cells of at most 10 digits each plus separators
+        if (w->len + 64 > PHOTO_WRITER_BUFFER)
+            photo_writer_flush(w);
+
+        s = w->buffer + w->len;
+        if (f->p < f->b) {
+            s = photo_format_cell(s, 'P', f->p);
+            *s++ = ',', *s++ = ' ';
+            s = photo_format_cell(s, 'A', f->a);
+            *s++ = ',', *s++ = ' ';
+            s = photo_format_cell(s, 'B', f->b);
+        } else {
+            s = photo_format_cell(s, 'B', f->b);
+            *s++ = ',', *s++ = ' ';
+            s = photo_format_cell(s, 'A', f->a);
+            *s++ = ',', *s++ = ' ';
+            s = photo_format_cell(s, 'P', f->p);
+        };
+        *s++ = '\n';
+        w->len = s - w->buffer;
+    };
+}
+
+
+/*
+ * A photo_sink_t for when only the enumeration itself is of interest.
+ */
+void photo_discard_sink(const photo_t *photo, int n, void *arg) {
+    (void)photo, (void)n, (void)arg;
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getArtisticPhotographCount(5, "APABA", 1, 2), 1);
@@ -80,5 +286,71 @@ int main(int argc, char **argv) {
         getArtisticPhotographCount(5, "APABA", 2, 3), 0);
     printf("result = %d, expected = %d\n",
         getArtisticPhotographCount(8, ".PBAAP.B", 1, 3), 3);
+
+    // list the photographs of the last sample, through a tiny batch
+    photo_t batch[2];
+    photo_writer_t *w = photo_writer_new(STDOUT_FILENO, PHOTO_TEXT);
+    long long n;
+
+    fflush(stdout);
+    n = enumerateArtisticPhotographs(8, ".PBAAP.B", 1, 3, batch, 2, photo_writer_sink, w);
+    photo_writer_delete(w);
+    printf("result = %lld, expected = %d\n", n, 3);
+
+    // the enumeration and the count agree on every window of a longer set
+    char *C = "PAB.PAABBP.APBAPBBA.PPAB";
+    int N = strlen(C), mismatches = 0;
+    photo_t big[64];
+    for (int X = 1; X <= N; X++)
+        for (int Y = X; Y <= N; Y++)
+            mismatches += enumerateArtisticPhotographs(N, C, X, Y, big, 64,
+                photo_discard_sink, NULL) != getArtisticPhotographCount(N, C, X, Y);
+    printf("result = %d, expected = %d\n", mismatches, 0);
+}
+
+#else
+
+long long enumerateOnly(int N, char *C, int X, int Y) {
+    photo_t batch[4096];
+
+    return enumerateArtisticPhotographs(N, C, X, Y, batch, 4096, photo_discard_sink, NULL);
+}
+
+
+long long writeArtisticPhotographs(int N, char *C, int X, int Y, int format) {
+    photo_t batch[4096];
+    int fd = open("/dev/null", O_WRONLY);
+    photo_writer_t *w = photo_writer_new(fd, format);
+    long long result;
+
+    result = enumerateArtisticPhotographs(N, C, X, Y, batch, 4096, photo_writer_sink, w);
+    photo_writer_delete(w);
+    close(fd);
+
+    return result;
+}
+
+
+int main(int argc, char **argv) {
+    int N = 200;
+    char C[N+1];
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        C[i] = "PAB."[bench_range(0, 3)];
+    C[N] = '\0';
+    BENCH_CASE("random", N, 5, , getArtisticPhotographCount(N, C, 1, N));
+    BENCH_CASE("random-enumerate", N, 5, , enumerateOnly(N, C, 1, N));
+    BENCH_CASE("random-text", N, 5, , writeArtisticPhotographs(N, C, 1, N, PHOTO_TEXT));
+
+    // every photographer, actor, and backdrop combination is artistic
+    bench_seed(0);
+    for (int i = 0; i < N; i++)
+        C[i] = i < N/3 ? 'P' : i < 2*N/3 ? 'A' : 'B';
+    BENCH_CASE("dense", N, 5, , getArtisticPhotographCount(N, C, 1, N));
+    BENCH_CASE("dense-enumerate", N, 5, , enumerateOnly(N, C, 1, N));
+    BENCH_CASE("dense-text", N, 5, , writeArtisticPhotographs(N, C, 1, N, PHOTO_TEXT));
+    BENCH_CASE("dense-binary", N, 5, , writeArtisticPhotographs(N, C, 1, N, PHOTO_BINARY));
 }
 
+#endif
@@ -34,11 +34,41 @@
  * N = 8, C = ".PBAAP.B", X = 1, Y = 3  ->  result = 3
  */
 
+/*
+ * Solution
+ *
+ * An artistic photograph with its actor in cell j has the photographer X to
+ * Y cells to one side of j and the backdrop X to Y cells to the other side.
+ * Walking the actors from left to right, the photographers and backdrops in
+ * the four windows around the actor are delimited by pointers into the
+ * sorted lists of photographer and backdrop cells which only ever move
+ * right, so each actor adds two products of window sizes in O(1) amortized.
+ *
+ * The same count can be taken while the set streams by: an actor's windows
+ * are known once the cell Y to its right has been read, and only the prefix
+ * counts of photographers and backdrops over the last 2Y+2 cells are needed
+ * to get them.  photo_stream_t keeps those in a ring buffer, for O(N) time
+ * and O(Y) memory on sets too large to hold in memory.
+ */
+
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+#ifdef BENCH
+#include "bench.h"
+#endif
+
+#define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
+#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
 
 
 long long getArtisticPhotographCount(int N, char *C, int X, int Y) {
-    int P[N], A[N], B[N];
+    int *P = malloc(3 * (size_t)N * sizeof *P), *A = P + N, *B = A + N;
     int NP = 0, NA = 0, NB = 0;
     int ill = 0, ilr = 0, irl = 0, irr = 0;
     int kll = 0, klr = 0, krl = 0, krr = 0;
@@ -64,14 +94,413 @@ long long getArtisticPhotographCount(int N, char *C, int X, int Y) {
         while (klr < krl && B[klr] <= A[j] - X) klr++;
         while (kll < klr && B[kll] < A[j] - Y) kll++;
 
-        result += (ilr-ill) * (krr-krl);
-        result += (irr-irl) * (klr-kll);
+        result += (long long)(ilr-ill) * (krr-krl);
+        result += (long long)(irr-irl) * (klr-kll);
+    };
+
+    free(P);
+
+    return result;
+}
+
+
+/*
+ * Parallel sweep.
+ *
+ * The index arrays are built in parallel, each thread counting the
+ * photographers, actors, and backdrops in its part of C and then, at
+ * offsets given by the counts of the threads before it, filling them in.
+ * Counting first also sizes the arrays exactly, at one int per cell.
+ * The actors are then split into contiguous chunks, one per thread, and each
+ * thread finds where the eight pointers of the sweep stand at its first
+ * actor by binary search before sweeping its chunk as above.  The partial
+ * sums are added up at the end.
+ */
+
+typedef struct photo_sweep {
+    int N, X, Y;
+    char *C;
+    int *P, *A, *B;                 // [NP], [NA], [NB]
+    int NP, NA, NB;
+    int (*count)[3];                // [num_threads] cells of each kind
+    long long *result;              // [num_threads]
+} photo_sweep_t;
+
+
+/*
+ * Number of x[0..n) smaller than v.
+ */
+static int photo_lower_bound(const int *x, int n, long long v) {
+    int lo = 0, hi = n;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+
+        if (x[mid] < v)
+            lo = mid + 1;
+        else
+            hi = mid;
+    };
+
+    return lo;
+}
+
+
+void photo_sweep_count(void *arg, int t, int num_threads) {
+    photo_sweep_t *w = arg;
+    long long lo, hi;
+
+    parallel_range(w->N, t, num_threads, &lo, &hi);
+    w->count[t][0] = w->count[t][1] = w->count[t][2] = 0;
+    for (long long n = lo; n < hi; n++) {
+        switch (w->C[n]) {
+            case 'P': w->count[t][0]++; break;
+            case 'A': w->count[t][1]++; break;
+            case 'B': w->count[t][2]++; break;
+        };
+    };
+}
+
+
+void photo_sweep_fill(void *arg, int t, int num_threads) {
+    photo_sweep_t *w = arg;
+    int np = 0, na = 0, nb = 0;
+    long long lo, hi;
+
+    for (int u = 0; u < t; u++) {
+        np += w->count[u][0];
+        na += w->count[u][1];
+        nb += w->count[u][2];
+    };
+
+    parallel_range(w->N, t, num_threads, &lo, &hi);
+    for (long long n = lo; n < hi; n++) {
+        switch (w->C[n]) {
+            case 'P': w->P[np++] = n; break;
+            case 'A': w->A[na++] = n; break;
+            case 'B': w->B[nb++] = n; break;
+        };
+    };
+}
+
+
+void photo_sweep_run(void *arg, int t, int num_threads) {
+    photo_sweep_t *w = arg;
+    const int *P = w->P, *A = w->A, *B = w->B;
+    int NP = w->NP, NB = w->NB;
+    long long X = w->X, Y = w->Y, j0, j1;
+    int ill, ilr, irl, irr, kll, klr, krl, krr;
+    long long result = 0;
+
+    parallel_range(w->NA, t, num_threads, &j0, &j1);
+    if (j0 < j1) {
+        ill = photo_lower_bound(P, NP, A[j0] - Y);
+        ilr = photo_lower_bound(P, NP, A[j0] - X + 1);
+        irl = photo_lower_bound(P, NP, A[j0] + X);
+        irr = photo_lower_bound(P, NP, A[j0] + Y + 1);
+        kll = photo_lower_bound(B, NB, A[j0] - Y);
+        klr = photo_lower_bound(B, NB, A[j0] - X + 1);
+        krl = photo_lower_bound(B, NB, A[j0] + X);
+        krr = photo_lower_bound(B, NB, A[j0] + Y + 1);
+    };
+
+    for (long long j = j0; j < j1; j++) {
+        long long a = A[j];
+
+        while (irr < NP && P[irr] <= a + Y) irr++;
+        while (irl < irr && P[irl] < a + X) irl++;
+        while (ilr < irl && P[ilr] <= a - X) ilr++;
+        while (ill < ilr && P[ill] < a - Y) ill++;
+
+        while (krr < NB && B[krr] <= a + Y) krr++;
+        while (krl < krr && B[krl] < a + X) krl++;
+        while (klr < krl && B[klr] <= a - X) klr++;
+        while (kll < klr && B[kll] < a - Y) kll++;
+
+        result += (long long)(ilr-ill) * (krr-krl);
+        result += (long long)(irr-irl) * (klr-kll);
+    };
+
+    w->result[t] = result;
+}
+
+
+/*
+ * Same result as getArtisticPhotographCount() on the given number of
+ * threads, or parallel_threads() if that is <= 0.
+ */
+long long getArtisticPhotographCountParallel(int N, char *C, int X, int Y, int num_threads) {
+    photo_sweep_t w = { .N = N, .X = X, .Y = Y, .C = C };
+    long long result = 0;
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+
+    w.count = malloc(num_threads * sizeof *w.count);
+    w.result = malloc(num_threads * sizeof *w.result);
+
+    parallel_run(num_threads, photo_sweep_count, &w);
+    w.NP = w.NA = w.NB = 0;
+    for (int t = 0; t < num_threads; t++) {
+        w.NP += w.count[t][0];
+        w.NA += w.count[t][1];
+        w.NB += w.count[t][2];
+    };
+
+    // one cell index per cell rather than three
+    w.P = malloc(((size_t)w.NP + w.NA + w.NB) * sizeof *w.P);
+    w.A = w.P + w.NP;
+    w.B = w.A + w.NA;
+    parallel_run(num_threads, photo_sweep_fill, &w);
+    parallel_run(num_threads, photo_sweep_run, &w);
+
+    for (int t = 0; t < num_threads; t++)
+        result += w.result[t];
+
+    free(w.result);
+    free(w.count);
+    free(w.P);
+
+    return result;
+}
+
+
+/*
+ * Streaming count.
+ *
+ * Cell n of the stream is at ring position n & mask, and prefix[n & mask]
+ * holds the number of photographers and backdrops in cells 0, ..., n-1.
+ * After cell n-1 has been read the actor in cell j = n-Y-1 is counted, which
+ * needs the prefix counts at j-Y, ..., n, so the ring must hold 2Y+2 of them.
+ */
+
+typedef struct photo_prefix {
+    long long p, b;
+} photo_prefix_t;
+
+
+typedef struct photo_stream {
+    long long X, Y;
+    long long n;                    // number of cells read
+    long long mask;                 // ring size - 1
+    long long result;
+    photo_prefix_t *prefix;         // [mask+1]
+    char *cell;                     // [mask+1]
+} photo_stream_t;
+
+
+photo_stream_t *photo_stream_new(long long X, long long Y) {
+    photo_stream_t *s = malloc(sizeof *s);
+    long long size = 1;
+
+    while (size < 2*Y + 2)
+        size *= 2;
+
+    s->X = X;
+    s->Y = Y;
+    s->n = 0;
+    s->mask = size - 1;
+    s->result = 0;
+    s->prefix = malloc(size * sizeof *s->prefix);
+    s->cell = malloc(size);
+    s->prefix[0] = (photo_prefix_t){ 0, 0 };
+
+    return s;
+}
+
+
+void photo_stream_delete(photo_stream_t *s) {
+    if (!s)
+        return;
+
+    free(s->prefix);
+    free(s->cell);
+    free(s);
+}
+
+
+static inline photo_prefix_t photo_stream_prefix(photo_stream_t *s, long long i) {
+    return s->prefix[(i < 0 ? 0 : i) & s->mask];
+}
+
+
+/*
+ * Read the next len cells of the set.  Any character other than P, A, and B
+ * is an empty cell.
+ */
+void photo_stream_feed(photo_stream_t *s, const char *C, size_t len) {
+    long long X = s->X, Y = s->Y, mask = s->mask;
+    photo_prefix_t *prefix = s->prefix;
+
+    for (size_t i = 0; i < len; i++) {
+        long long n = s->n, j = n - Y;
+        photo_prefix_t here = prefix[n & mask];
+
+        s->cell[n & mask] = C[i];
+        here.p += C[i] == 'P';
+        here.b += C[i] == 'B';
+        prefix[(n+1) & mask] = here;
+        s->n = n + 1;
+
+        if (j >= 0 && s->cell[j & mask] == 'A') {
+            photo_prefix_t ll = photo_stream_prefix(s, j-Y);
+            photo_prefix_t lr = photo_stream_prefix(s, j-X+1);
+            photo_prefix_t rl = prefix[(j+X) & mask];
+
+            // here is the prefix at j+Y+1
+            s->result += (lr.p - ll.p) * (here.b - rl.b)
+                       + (lr.b - ll.b) * (here.p - rl.p);
+        };
     };
+}
+
+
+/*
+ * Count the actors in the last Y cells, whose right windows are cut off by
+ * the end of the set, and return the number of artistic photographs.
+ */
+long long photo_stream_finish(photo_stream_t *s) {
+    char empty[4096];
+
+    memset(empty, '.', sizeof empty);
+    for (long long i = 0; i < s->Y; i += sizeof empty)
+        photo_stream_feed(s, empty, MIN(s->Y - i, (long long)sizeof empty));
+
+    return s->result;
+}
+
+
+/*
+ * Count the artistic photographs of the set read from fd until end of file,
+ * or return -1 if reading fails.
+ */
+long long getArtisticPhotographCountFd(int fd, int X, int Y) {
+    photo_stream_t *s = photo_stream_new(X, Y);
+    char buffer[1 << 16];
+    long long result;
+    ssize_t len;
+
+    while ((len = read(fd, buffer, sizeof buffer)) != 0) {
+        if (len < 0 && errno == EINTR)
+            continue;
+        if (len < 0) {
+            photo_stream_delete(s);
+            return -1;
+        };
+        photo_stream_feed(s, buffer, len);
+    };
+
+    result = photo_stream_finish(s);
+    photo_stream_delete(s);
 
     return result;
 }
 
 
+/*
+ * Precomputed index for many queries on the same set.
+ *
+ * The count for (X, Y) sums, over the actors, products of the photographer
+ * count on one side with the backdrop count on the other, so it does not
+ * factor into histograms of photographer-actor and actor-backdrop distances.
+ * What does carry over between queries is everything but the sum itself: the
+ * actor cells and the prefix counts of photographers and backdrops, which
+ * photo_index_t holds padded by N cells on both sides so that no window
+ * needs clamping.  A query is then four lookups per actor, and a batch of
+ * queries is answered a block of actors at a time so that the actors stay
+ * in cache across the queries.
+ */
+
+#define PHOTO_INDEX_BLOCK   2048
+
+typedef struct photo_index_prefix {
+    int p, b;
+} photo_index_prefix_t;
+
+
+typedef struct photo_index {
+    int N, NA;
+    int *actor;                     // [NA] actor cells in order
+    photo_index_prefix_t *prefix;   // [3N+1] counts in cells -N, ..., i-N-1
+} photo_index_t;
+
+
+photo_index_t *photo_index_new(int N, char *C) {
+    photo_index_t *x = malloc(sizeof *x);
+    photo_index_prefix_t *prefix;
+
+    x->N = N;
+    x->NA = 0;
+    x->actor = malloc(N * sizeof *x->actor);
+    x->prefix = prefix = malloc((3 * (size_t)N + 1) * sizeof *x->prefix);
+
+    for (int i = 0; i <= N; i++)
+        prefix[i] = (photo_index_prefix_t){ 0, 0 };
+    for (int i = 0; i < N; i++) {
+        prefix[N+i+1].p = prefix[N+i].p + (C[i] == 'P');
+        prefix[N+i+1].b = prefix[N+i].b + (C[i] == 'B');
+        if (C[i] == 'A')
+            x->actor[x->NA++] = i;
+    };
+    for (int i = 2*N+1; i <= 3*N; i++)
+        prefix[i] = prefix[2*N];
+
+    return x;
+}
+
+
+void photo_index_delete(photo_index_t *x) {
+    if (!x)
+        return;
+
+    free(x->actor);
+    free(x->prefix);
+    free(x);
+}
+
+
+static long long photo_index_sum(const photo_index_t *x, int lo, int hi, int X, int Y) {
+    const photo_index_prefix_t *prefix = x->prefix + x->N;
+    long long result = 0;
+
+    for (int j = lo; j < hi; j++) {
+        int a = x->actor[j];
+        photo_index_prefix_t ll = prefix[a-Y], lr = prefix[a-X+1];
+        photo_index_prefix_t rl = prefix[a+X], rr = prefix[a+Y+1];
+
+        result += (long long)(lr.p - ll.p) * (rr.b - rl.b)
+                + (long long)(lr.b - ll.b) * (rr.p - rl.p);
+    };
+
+    return result;
+}
+
+
+long long photo_index_count(const photo_index_t *x, int X, int Y) {
+    return photo_index_sum(x, 0, x->NA, X, Y);
+}
+
+
+/*
+ * Answer the queries (X[q], Y[q]) for q = 0, ..., Q-1 into result[q].
+ */
+void photo_index_count_batch(const photo_index_t *x, int Q, const int *X, const int *Y,
+        long long *result)
+{
+    for (int q = 0; q < Q; q++)
+        result[q] = 0;
+
+    for (int lo = 0; lo < x->NA; lo += PHOTO_INDEX_BLOCK) {
+        int hi = MIN(x->NA, lo + PHOTO_INDEX_BLOCK);
+
+        for (int q = 0; q < Q; q++)
+            result[q] += photo_index_sum(x, lo, hi, X[q], Y[q]);
+    };
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %lld, expected = %d\n",
         getArtisticPhotographCount(5, "APABA", 1, 2), 1);
@@ -79,5 +508,148 @@ int main(int argc, char **argv) {
         getArtisticPhotographCount(5, "APABA", 2, 3), 0);
     printf("result = %lld, expected = %d\n",
         getArtisticPhotographCount(8, ".PBAAP.B", 1, 3), 3);
+
+    // the streaming count agrees with the in-memory one, for any chunking
+    char C[2000];
+    int mismatches = 0;
+    srand(1);
+    for (int i = 0; i < 2000; i++)
+        C[i] = "PAB."[rand() % 4];
+    for (int t = 0; t < 200; t++) {
+        int N = rand() % 2000 + 1, X = rand() % N + 1, Y = X + rand() % (N-X+1);
+        photo_stream_t *s = photo_stream_new(X, Y);
+
+        for (int i = 0, len; i < N; i += len) {
+            len = rand() % 64 + 1;
+            len = MIN(N-i, len);
+            photo_stream_feed(s, C+i, len);
+        };
+        mismatches += photo_stream_finish(s) != getArtisticPhotographCount(N, C, X, Y);
+        photo_stream_delete(s);
+    };
+    printf("result = %d, expected = %d\n", mismatches, 0);
+
+    // and so does the parallel sweep, on more threads than actors too
+    mismatches = 0;
+    for (int t = 0; t < 200; t++) {
+        int N = rand() % 2000 + 1, X = rand() % N + 1, Y = X + rand() % (N-X+1);
+
+        mismatches += getArtisticPhotographCountParallel(N, C, X, Y, t % 8 + 1)
+            != getArtisticPhotographCount(N, C, X, Y);
+    };
+    mismatches += getArtisticPhotographCountParallel(5, "APABA", 1, 2, 16) != 1;
+    printf("result = %d, expected = %d\n", mismatches, 0);
+
+    // and so does the index, on every window of a shorter set
+    int N = 300, Q = 0, QX[N*(N+1)/2], QY[N*(N+1)/2];
+    long long count[N*(N+1)/2];
+    photo_index_t *x = photo_index_new(N, C);
+    for (int X = 1; X <= N; X++)
+        for (int Y = X; Y <= N; Y++)
+            QX[Q] = X, QY[Q] = Y, Q++;
+    photo_index_count_batch(x, Q, QX, QY, count);
+    mismatches = 0;
+    for (int q = 0; q < Q; q++)
+        mismatches += count[q] != getArtisticPhotographCount(N, C, QX[q], QY[q])
+            || count[q] != photo_index_count(x, QX[q], QY[q]);
+    photo_index_delete(x);
+    printf("result = %d, expected = %d\n", mismatches, 0);
+}
+
+#else
+
+long long streamArtisticPhotographCount(int N, char *C, int X, int Y) {
+    photo_stream_t *s = photo_stream_new(X, Y);
+    long long result;
+
+    photo_stream_feed(s, C, N);
+    result = photo_stream_finish(s);
+    photo_stream_delete(s);
+
+    return result;
+}
+
+
+/*
+ * Q windows answered one call at a time, as a checksum of the results.
+ */
+long long repeatArtisticPhotographCount(int N, char *C, int Q, int *X, int *Y) {
+    long long sum = 0;
+
+    for (int q = 0; q < Q; q++)
+        sum += getArtisticPhotographCount(N, C, X[q], Y[q]);
+
+    return sum;
+}
+
+
+long long batchArtisticPhotographCount(int N, char *C, int Q, int *X, int *Y) {
+    photo_index_t *x = photo_index_new(N, C);
+    long long result[Q], sum = 0;
+
+    photo_index_count_batch(x, Q, X, Y, result);
+    for (int q = 0; q < Q; q++)
+        sum += result[q];
+    photo_index_delete(x);
+
+    return sum;
+}
+
+
+int main(int argc, char **argv) {
+    int N = 300000;
+    char *C = malloc(N+1);
+    FILE *f = tmpfile();
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        C[i] = "PAB."[bench_range(0, 3)];
+    C[N] = '\0';
+    BENCH_CASE("random", N, 5, , getArtisticPhotographCount(N, C, 1000, 100000));
+    BENCH_CASE("random-parallel", N, 5, ,
+        getArtisticPhotographCountParallel(N, C, 1000, 100000, 0));
+    BENCH_CASE("random-stream", N, 5, ,
+        streamArtisticPhotographCount(N, C, 1000, 100000));
+    BENCH_CASE("random-stream-narrow", N, 5, ,
+        streamArtisticPhotographCount(N, C, 10, 100));
+
+    fwrite(C, 1, N, f);
+    fflush(f);
+    BENCH_CASE("random-fd", N, 5, lseek(fileno(f), 0, SEEK_SET),
+        getArtisticPhotographCountFd(fileno(f), 1000, 100000));
+    fclose(f);
+
+    // 64 random windows on the same set
+    int Q = 64, X[Q], Y[Q];
+    bench_seed(2);
+    for (int q = 0; q < Q; q++) {
+        X[q] = bench_range(1, N);
+        Y[q] = bench_range(X[q], MIN(N, X[q] + 100000));
+    };
+    BENCH_CASE("random-64-windows", N, 3, , repeatArtisticPhotographCount(N, C, Q, X, Y));
+    BENCH_CASE("random-64-windows-batch", N, 3, , batchArtisticPhotographCount(N, C, Q, X, Y));
+
+    // every photographer, actor, and backdrop combination is artistic
+    bench_seed(0);
+    for (int i = 0; i < N; i++)
+        C[i] = i < N/3 ? 'P' : i < 2*N/3 ? 'A' : 'B';
+    BENCH_CASE("dense", N, 5, , getArtisticPhotographCount(N, C, 1, N));
+    BENCH_CASE("dense-parallel", N, 5, , getArtisticPhotographCountParallel(N, C, 1, N, 0));
+
+    free(C);
+
+    // far beyond the constraints, only when asked for with "large"
+    if (argc > 1 && strcmp(argv[1], "large") == 0) {
+        N = 200000000;
+        C = malloc(N);
+        bench_seed(3);
+        for (int i = 0; i < N; i++)
+            C[i] = "PAB."[bench_rand() & 3];
+        BENCH_CASE("large", N, 1, , getArtisticPhotographCount(N, C, 1000, 100000));
+        BENCH_CASE("large-parallel", N, 1, ,
+            getArtisticPhotographCountParallel(N, C, 1000, 100000, 0));
+        free(C);
+    };
 }
 
+#endif
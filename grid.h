@@ -0,0 +1,167 @@
+/*
+ * Character grids shared by the puzzle programs.
+ *
+ * A grid_t holds R rows of C cells row-major in one buffer, row i starting
+ * i*stride bytes into it, so a row is found by arithmetic instead of
+ * through an array of row pointers.  A grid is either mapped from a file
+ * or a view of rows already in memory:
+ *
+ * - grid_open() maps a file read-only and uses the cells where they are in
+ *   the mapping.  Text files hold one row per line, every line ending in
+ *   '\n' except maybe the last, for a stride of C+1.  Binary files, as
+ *   written by grid_save(), start with the 16-byte header "GRID" followed
+ *   by rows, cols and stride as native 32-bit integers, and then hold
+ *   rows*stride bytes of cells.  Only the header and the file size are
+ *   looked at in a binary file, so opening it takes the same time for any
+ *   size of grid, and the pages are read as the solver gets to them.  In a
+ *   text file the line lengths are checked as well, by looking for the
+ *   '\n' at the end of every row, which touches one byte per row.  A '\n'
+ *   within a row whose end is in place is not noticed and reads as a cell.
+ * - grid_wrap() views rows given as pointers without copying them if they
+ *   are evenly spaced, as rows cut from one allocation are, and packs a
+ *   copy of them otherwise.
+ *
+ * grid_free() releases either kind.
+ */
+
+#ifndef GRID_H
+#define GRID_H
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+#define GRID_HEADER     16
+
+
+typedef struct grid {
+    int rows, cols;
+    size_t stride;                  // bytes from the start of a row to the next
+    const char *cells;              // first cell of row 0
+    void *base;                     // mapping or copy to release, if any
+    size_t size;                    // size of the mapping, 0 for a copy
+} grid_t;
+
+
+static inline const char *grid_row(const grid_t *g, int i) {
+    return g->cells + (size_t)i * g->stride;
+}
+
+
+static inline void grid_free(grid_t *g) {
+    if (g->size)
+        munmap(g->base, g->size);
+    else
+        free(g->base);
+    memset(g, 0, sizeof *g);
+}
+
+
+/*
+ * Map the grid in the file at path.  Returns 0 if it worked, or -1 if the
+ * file can't be read or is not a grid.
+ */
+static inline int grid_open(grid_t *g, const char *path) {
+    int fd = open(path, O_RDONLY), ok;
+    struct stat st;
+    const char *p, *eol;
+
+    memset(g, 0, sizeof *g);
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        close(fd);
+        return -1;
+    };
+
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        return -1;
+    g->base = (void *)p;
+    g->size = st.st_size;
+
+    if (g->size >= GRID_HEADER && memcmp(p, "GRID", 4) == 0) {
+        int32_t h[3];
+
+        memcpy(h, p+4, sizeof h);
+        g->rows = h[0], g->cols = h[1], g->stride = h[2];
+        g->cells = p + GRID_HEADER;
+        ok = g->rows > 0 && g->cols > 0 && h[2] >= h[1]
+            && (g->size - GRID_HEADER) / g->stride >= (size_t)g->rows;
+    } else {
+        eol = memchr(p, '\n', g->size);
+        g->cols = eol ? eol - p : (long long)g->size;
+        g->stride = g->cols + 1;
+        g->rows = (g->size + 1) / g->stride;
+        g->cells = p;
+        ok = g->cols > 0 && (g->size + 1) % g->stride <= 1;
+        for (int i = 0; i < g->rows - 1 && ok; i++)
+            ok = grid_row(g, i)[g->cols] == '\n';
+    };
+
+    if (!ok) {
+        grid_free(g);
+        return -1;
+    };
+
+    return 0;
+}
+
+
+/*
+ * View the R rows of C cells G[0..R).
+ */
+static inline void grid_wrap(grid_t *g, int R, int C, char **G) {
+    ptrdiff_t stride = R > 1 ? G[1] - G[0] : C;
+    int even = stride >= C;
+    char *copy;
+
+    for (int i = 2; i < R && even; i++)
+        even = G[i] - G[i-1] == stride;
+
+    g->rows = R;
+    g->cols = C;
+    if (even) {
+        g->stride = stride;
+        g->cells = G[0];
+        g->base = NULL;
+    } else {
+        copy = malloc((size_t)R*C);
+        for (int i = 0; i < R; i++)
+            memcpy(copy + (size_t)i*C, G[i], C);
+        g->stride = C;
+        g->cells = g->base = copy;
+    };
+    g->size = 0;
+}
+
+
+/*
+ * Write the grid to the file at path in the binary format, with the rows
+ * packed.  Returns 0 if it worked and -1 otherwise.
+ */
+static inline int grid_save(const grid_t *g, const char *path) {
+    FILE *f = fopen(path, "wb");
+    int32_t h[3] = { g->rows, g->cols, g->cols };
+    int ok;
+
+    if (!f)
+        return -1;
+
+    ok = fwrite("GRID", 4, 1, f) == 1 && fwrite(h, sizeof h, 1, f) == 1;
+    for (int i = 0; i < g->rows && ok; i++)
+        ok = fwrite(grid_row(g, i), g->cols, 1, f) == 1;
+
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+
+#endif
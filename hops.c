@@ -33,20 +33,242 @@
  * N = 6, F = 3, P = [5,2,4]    -> result = 4
  */
 
+/*
+ * Solution
+ *
+ * The frog furthest back can only ever get to the shore by hops of its own,
+ * and each of those takes it at least one pad forward, so N - min(P) seconds
+ * are needed.  They also suffice: as long as the frog furthest back hops
+ * every second, it jumps to the pad right after the group of adjacent frogs
+ * it is part of, so the group moves one pad forward per second, picking up
+ * every group it runs into, until it reaches pad N-1 and its frogs exit one
+ * per second.
+ *
+ * simulateHops() plays that schedule out to check the closed form.  The
+ * occupied pads are kept as runs of adjacent frogs, so a group rolling
+ * across any number of empty pads is a single event, and the whole schedule
+ * is F+1 events at most, whatever N is.
+ */
+
+#include <fcntl.h>
+#include <immintrin.h>
 #include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "parallel.h"
+#include "radix-sort.h"
 
-long long getSecondsRequired(long long N, int F, long long *P) {
+#ifdef BENCH
+#include "bench.h"
+#endif
+
+#define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
+#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
+
+
+/*
+ * Minimum reduction.
+ *
+ * Only min(P) is needed, so the solver is a single streaming pass and the
+ * point is to keep up with memory.  The AVX2 kernel compares four pads per
+ * instruction in four independent accumulators, and large inputs are split
+ * into one contiguous range per thread.  Inputs below PAD_MIN_PER_THREAD
+ * pads per thread stay on fewer threads, as starting threads would cost more
+ * than it saves.  Frog positions arriving as files of packed native 64-bit
+ * integers are mapped into memory rather than read.
+ */
+
+#define PAD_MIN_PER_THREAD  (1 << 20)
+
+
+long long pad_min(const long long *P, long long n) {
     long long p = LLONG_MAX;
 
-    for (; F--; P++)
+    for (; n--; P++)
         if (*P < p) p = *P;
 
-    return N-p;
+    return p;
+}
+
+
+__attribute__((target("avx2")))
+long long pad_min_avx2(const long long *P, long long n) {
+    __m256i vmin[4];
+    long long m[4], i;
+
+    for (int k = 0; k < 4; k++)
+        vmin[k] = _mm256_set1_epi64x(LLONG_MAX);
+
+    for (i = 0; i+16 <= n; i += 16) {
+        for (int k = 0; k < 4; k++) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(P+i+4*k));
+            vmin[k] = _mm256_blendv_epi8(vmin[k], v, _mm256_cmpgt_epi64(vmin[k], v));
+        };
+    };
+
+    for (int k = 1; k < 4; k++)
+        vmin[0] = _mm256_blendv_epi8(vmin[0], vmin[k], _mm256_cmpgt_epi64(vmin[0], vmin[k]));
+    _mm256_storeu_si256((__m256i *)m, vmin[0]);
+    m[0] = MIN(MIN(m[0], m[1]), MIN(m[2], m[3]));
+
+    return MIN(m[0], pad_min(P+i, n-i));
+}
+
+
+typedef struct pad_reduction {
+    const long long *P;
+    long long n;
+    long long *min;                 // [num_threads]
+    long long (*kernel)(const long long *P, long long n);
+} pad_reduction_t;
+
+
+void pad_min_worker(void *arg, int t, int num_threads) {
+    pad_reduction_t *r = arg;
+    long long lo, hi;
+
+    parallel_range(r->n, t, num_threads, &lo, &hi);
+    r->min[t] = r->kernel(r->P + lo, hi - lo);
+}
+
+
+/*
+ * min(P[0..n)) on up to num_threads threads, or parallel_threads() if that
+ * is <= 0.
+ */
+long long pad_min_parallel(const long long *P, long long n, int num_threads) {
+    pad_reduction_t r = {
+        .P = P, .n = n,
+        .kernel = __builtin_cpu_supports("avx2") ? pad_min_avx2 : pad_min,
+    };
+    long long p = LLONG_MAX;
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    num_threads = MAX(1, MIN(num_threads, n / PAD_MIN_PER_THREAD));
+    if (num_threads == 1)
+        return r.kernel(P, n);
+
+    r.min = malloc(num_threads * sizeof *r.min);
+    parallel_run(num_threads, pad_min_worker, &r);
+    for (int t = 0; t < num_threads; t++)
+        p = MIN(p, r.min[t]);
+    free(r.min);
+
+    return p;
+}
+
+
+long long getSecondsRequired(long long N, int F, long long *P) {
+    return N - pad_min_parallel(P, F, 0);
+}
+
+
+/*
+ * Same as getSecondsRequired() for the frog positions stored in the file
+ * at path as packed native 64-bit integers, or -1 if it can't be read.
+ */
+long long getSecondsRequiredFile(long long N, const char *path, int num_threads) {
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    long long *P, F, result;
+
+    if (fd < 0)
+        return -1;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof *P) {
+        close(fd);
+        return -1;
+    };
+
+    F = st.st_size / sizeof *P;
+    P = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (P == MAP_FAILED)
+        return -1;
+    madvise(P, st.st_size, MADV_SEQUENTIAL);
+
+    result = N - pad_min_parallel(P, F, num_threads);
+    munmap(P, st.st_size);
+
+    return result;
+}
+
+
+/*
+ * A compressed stretch of the schedule.  Starting after second `time`, the
+ * group of `frogs` frogs on pads back, ..., back+frogs-1 spends `seconds`
+ * seconds either rolling forward by that many pads (HOP_ROLL) or, once at
+ * pad N-1, exiting onto the shore (HOP_EXIT, where seconds == frogs).
+ */
+
+enum { HOP_ROLL, HOP_EXIT };
+
+typedef struct hop_event {
+    int kind;
+    long long time;
+    long long back, frogs;
+    long long seconds;
+} hop_event_t;
+
+
+/*
+ * The hop made in second e->time + i + 1, for 0 <= i < e->seconds: the back
+ * frog of the group, on pad *from, jumps to the first free pad *to after the
+ * group, which is N for the shore.
+ */
+void hop_event_hop(const hop_event_t *e, long long i, long long *from, long long *to) {
+    *from = e->back + i;
+    *to = e->back + e->frogs + (e->kind == HOP_ROLL ? i : 0);
+}
+
+
+/*
+ * Simulate the optimal schedule and return its length in seconds.  Unless
+ * event is NULL, the schedule is also stored to event[0..*num_events), which
+ * needs room for F+1 events.
+ */
+long long simulateHops(long long N, int F, long long *P, hop_event_t *event, int *num_events) {
+    long long *pad = malloc(2 * (size_t)F * sizeof *pad), *scratch = pad + F;
+    long long time = 0, back, frogs;
+    int n = 0;
+
+    memcpy(pad, P, F * sizeof *pad);
+    radix_sort_ll(pad, F, scratch);
+
+    // the rear group rolls into each run of adjacent frogs ahead of it
+    back = pad[0], frogs = 1;
+    for (int i = 1; i <= F; i++) {
+        long long seconds = (i < F ? pad[i] : N) - (back + frogs);
+
+        if (seconds > 0) {
+            if (event)
+                event[n++] = (hop_event_t){ HOP_ROLL, time, back, frogs, seconds };
+            time += seconds;
+            back += seconds;
+        };
+        if (i < F)
+            frogs++;
+    };
+
+    if (event) {
+        event[n++] = (hop_event_t){ HOP_EXIT, time, back, frogs, frogs };
+        *num_events = n;
+    };
+    time += frogs;
+
+    free(pad);
+
+    return time;
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %lld, expected = %d\n",
         getSecondsRequired(3, 1, (long long int []){1}), 2);
@@ -56,5 +278,114 @@ int main(int argc, char **argv) {
         getSecondsRequired(7, 3, (long long int []){5,2,3}), 5);
     printf("result = %lld, expected = %d\n",
         getSecondsRequired(6, 3, (long long int []){3,4,5}), 3);
+
+    // replay the simulated schedule hop by hop on random small ponds,
+    // checking every hop against the rules and the length against N - min(P)
+    int errors = 0;
+    srand(1);
+    for (int t = 0; t < 1000; t++) {
+        long long N = rand() % 40 + 2, P[40], from, to, seconds = 0;
+        int F = rand() % (N-1) + 1, num_events, frogs = F;
+        char frog[41] = { 0 };
+        hop_event_t event[41];
+
+        for (int i = 0; i < F; i++) {
+            do P[i] = rand() % (N-1) + 1; while (frog[P[i]]);
+            frog[P[i]] = 1;
+        };
+
+        errors += simulateHops(N, F, P, event, &num_events) != getSecondsRequired(N, F, P);
+        for (int e = 0; e < num_events; e++) {
+            errors += event[e].time != seconds;
+            for (long long i = 0; i < event[e].seconds; i++, seconds++) {
+                hop_event_hop(&event[e], i, &from, &to);
+                errors += !frog[from];
+                frog[from] = 0;
+                for (long long p = from+1; p < to; p++)
+                    errors += !frog[p];
+                if (to < N)
+                    errors += frog[to], frog[to] = 1;
+                else
+                    frogs--;
+            };
+        };
+        errors += frogs != 0 || seconds != getSecondsRequired(N, F, P);
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // the reductions agree with the scalar loop wherever the minimum is
+    int n = 3 * PAD_MIN_PER_THREAD + 17;
+    long long *P = malloc(n * sizeof *P);
+    errors = 0;
+    for (int i = 0; i < n; i++)
+        P[i] = (long long)rand() << 20 | rand();
+    for (int t = 0; t < 50; t++) {
+        int m = t < 25 ? t : rand() % n, len = t % 2 ? n : rand() % 100 + m+1;
+        long long p = P[m];
+
+        P[m] = -1 - t;
+        errors += pad_min_parallel(P, MIN(n, len), t % 5) != pad_min(P, MIN(n, len));
+        if (__builtin_cpu_supports("avx2"))
+            errors += pad_min_avx2(P, MIN(n, len)) != -1 - t;
+        P[m] = p;
+    };
+
+    // and the mapped file gives the same answer as the array
+    char path[] = "/tmp/hops-XXXXXX";
+    int fd = mkstemp(path);
+    errors += write(fd, P, n * sizeof *P) != (ssize_t)(n * sizeof *P);
+    close(fd);
+    errors += getSecondsRequiredFile(1LL << 62, path, 0) != getSecondsRequired(1LL << 62, n, P);
+    unlink(path);
+    errors += getSecondsRequiredFile(10, path, 0) != -1;
+    free(P);
+    printf("result = %d, expected = %d\n", errors, 0);
+}
+
+#else
+
+int main(int argc, char **argv) {
+    long long N = 1000000000000LL;
+    int F = 500000;
+    long long *P = malloc(F * sizeof *P);
+
+    // distinct pads spread over the whole trail
+    bench_seed(1);
+    P[0] = bench_range(1, N/F - 1);
+    for (int i = 1; i < F; i++)
+        P[i] = P[i-1] + bench_range(1, N/F - 1);
+    bench_shuffle_ll(P, F);
+    BENCH_CASE("random", F, 5, , getSecondsRequired(N, F, P));
+    BENCH_CASE("simulate", F, 5, , simulateHops(N, F, P, NULL, NULL));
+
+    int num_events;
+    hop_event_t *event = malloc((F+1) * sizeof *event);
+    BENCH_CASE("simulate-schedule", F, 5, , simulateHops(N, F, P, event, &num_events));
+    free(event);
+
+    // the reduction kernels on their own
+    BENCH_CASE("min-scalar", F, 5, , pad_min(P, F));
+    if (__builtin_cpu_supports("avx2"))
+        BENCH_CASE("min-avx2", F, 5, , pad_min_avx2(P, F));
+
+    // a 256 MB file of frog positions, far beyond the constraints
+    long long M = 32 << 20;
+    char path[] = "/tmp/hops-bench-XXXXXX";
+    int fd = mkstemp(path);
+    P = realloc(P, M * sizeof *P);
+    for (long long i = 0; i < M; i++)
+        P[i] = bench_range(1, N-1);
+    if (write(fd, P, M * sizeof *P) != (ssize_t)(M * sizeof *P))
+        perror(path);
+    close(fd);
+    BENCH_CASE("large-scalar", M, 5, , N - pad_min(P, M));
+    if (__builtin_cpu_supports("avx2"))
+        BENCH_CASE("large-avx2", M, 5, , N - pad_min_avx2(P, M));
+    BENCH_CASE("large-parallel", M, 5, , getSecondsRequired(N, M, P));
+    BENCH_CASE("large-file", M, 5, , getSecondsRequiredFile(N, path, 0));
+    unlink(path);
+
+    free(P);
 }
 
+#endif
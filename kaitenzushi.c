@@ -26,25 +26,274 @@
  * N = 7, D = [1,2,1,2,1,2,1], K = 2    -> result = 2
  */
 
+/*
+ * Solution
+ *
+ * Remembering for every dish type when it was last eaten, as its number in
+ * the order of dishes eaten, a dish is eaten if its type was never eaten or
+ * was eaten at least K dishes ago.  With dish types bounded by MAX_DISHES
+ * that is a table lookup per dish.
+ *
+ * For dish types from the whole int range, or a belt that never ends, a
+ * belt_t keeps the types of only the last K dishes eaten: in a ring buffer
+ * in the order they were eaten, and in an open-addressing hash set for the
+ * lookups.  Eating a dish replaces the oldest entry of the ring and moves
+ * its type out of the set, so each dish costs O(1) expected and memory is
+ * O(K) whatever the range of dish types.  The set uses linear probing with
+ * backward-shift deletion, which needs no tombstones, and is kept at most
+ * half full.
+ */
+
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "parallel.h"
+#include "radix-sort.h"
+
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 #define MAX_DISHES      1000000
 
+#define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
+#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
+
 
 int getMaximumEatenDishCount(int N, int *D, int K) {
-    int *H = calloc(MAX_DISHES, sizeof *H);
+    int *H = calloc(MAX_DISHES+1, sizeof *H);
     int result = 0;
 
     for (; N--; D++)
         if (H[*D] == 0 || result - H[*D] >= K)
             H[*D] = ++result;
 
+    free(H);
+
     return result;
 }
 
 
+typedef struct belt {
+    int K;
+    int eaten;                      // dishes eaten so far, up to K
+    int oldest;                     // ring position of the oldest dish eaten
+    int bits, mask;                 // hash set of 2^bits slots
+    uint64_t *slot;                 // [mask+1] types of the last K dishes eaten
+    int *recent;                    // [max_K] ring of those types, by age
+    int max_K;
+} belt_t;
+
+
+// set entries are the type shifted left with the low bit set, 0 is empty
+#define BELT_KEY(dish)      ( (uint64_t)(uint32_t)(dish) << 1 | 1 )
+
+
+static unsigned belt_hash(const belt_t *b, uint64_t key) {
+    return (uint32_t)((uint32_t)(key >> 1) * 0x9e3779b1u) >> (32 - b->bits);
+}
+
+
+/*
+ * Point the belt at a new K, growing the tables only if they are too small.
+ */
+static void belt_resize(belt_t *b, int K) {
+    int bits = 1;
+
+    while ((1 << bits) < 2*K)
+        bits++;
+
+    b->K = K;
+    if (bits > b->bits) {
+        b->bits = bits;
+        b->mask = (1 << bits) - 1;
+        free(b->slot);
+        b->slot = calloc(b->mask + 1, sizeof *b->slot);
+    };
+    if (K > b->max_K) {
+        b->max_K = K;
+        b->recent = realloc(b->recent, K * sizeof *b->recent);
+    };
+}
+
+
+belt_t *belt_new(int K) {
+    belt_t *b = calloc(1, sizeof *b);
+
+    belt_resize(b, K);
+
+    return b;
+}
+
+
+void belt_delete(belt_t *b) {
+    if (!b)
+        return;
+
+    free(b->slot);
+    free(b->recent);
+    free(b);
+}
+
+
+static void belt_remove(belt_t *b, uint64_t key) {
+    unsigned i = belt_hash(b, key), j;
+
+    while (b->slot[i] != key)
+        i = (i+1) & b->mask;
+
+    // shift back every later entry of the cluster that may move into i
+    for (j = (i+1) & b->mask; b->slot[j]; j = (j+1) & b->mask) {
+        unsigned home = belt_hash(b, b->slot[j]);
+
+        if (((j - home) & b->mask) >= ((j - i) & b->mask)) {
+            b->slot[i] = b->slot[j];
+            i = j;
+        };
+    };
+    b->slot[i] = 0;
+}
+
+
+/*
+ * Offer the next dish on the belt.  Returns 1 if it is eaten, 0 if it is
+ * the same type as one of the last K dishes eaten.
+ */
+int belt_push(belt_t *b, int dish) {
+    uint64_t key = BELT_KEY(dish);
+    unsigned i = belt_hash(b, key);
+
+    for (; b->slot[i]; i = (i+1) & b->mask)
+        if (b->slot[i] == key)
+            return 0;
+
+    if (b->eaten >= b->K) {
+        belt_remove(b, BELT_KEY(b->recent[b->oldest]));
+
+        // the removal may have shifted an entry into the free slot found
+        for (i = belt_hash(b, key); b->slot[i]; i = (i+1) & b->mask)
+            ;
+    };
+
+    b->slot[i] = key;
+    b->recent[b->oldest] = dish;
+    if (++b->oldest == b->K)
+        b->oldest = 0;
+    if (b->eaten < b->K)
+        b->eaten++;
+
+    return 1;
+}
+
+
+/*
+ * Empty the belt for a new run with the given K, reusing its memory.
+ */
+void belt_reset(belt_t *b, int K) {
+    for (int i = 0; i < b->K && i < b->eaten; i++)
+        belt_remove(b, BELT_KEY(b->recent[i]));
+
+    b->eaten = b->oldest = 0;
+    belt_resize(b, K);
+}
+
+
+/*
+ * Answers for many K on the same belt.
+ *
+ * The dish types are first renumbered 0, ..., T-1 by radix sorting the
+ * pairs (D[i], i), so that the last-eaten table has one entry per type that
+ * actually occurs and fits in cache far better than one per possible type.
+ * Worker threads then claim the K values one at a time and run the belt
+ * against the shared renumbered dishes, each with a table of its own.
+ *
+ * The tables are never cleared between runs.  Each run numbers its dishes
+ * eaten from where the previous run of the thread stopped, so an entry left
+ * by an earlier run is below the run's base and reads as never eaten.  Only
+ * when the numbers would overflow is the table zeroed again.
+ */
+
+typedef struct eaten_batch {
+    int N, T;
+    const int *type;                // [N] dish types renumbered
+    int Q;
+    const int *K;                   // [Q]
+    int *result;                    // [Q]
+    int next_query;
+} eaten_batch_t;
+
+
+void eaten_batch_worker(void *arg, int t, int num_threads) {
+    eaten_batch_t *e = arg;
+    int *H = calloc(e->T, sizeof *H), base = 0, q;
+
+    (void)t, (void)num_threads;
+
+    while ((q = __atomic_fetch_add(&e->next_query, 1, __ATOMIC_RELAXED)) < e->Q) {
+        int K = e->K[q], eaten = base;
+
+        if (base > INT_MAX - e->N) {
+            memset(H, 0, e->T * sizeof *H);
+            base = eaten = 0;
+        };
+
+        for (int i = 0; i < e->N; i++) {
+            int h = H[e->type[i]];
+
+            if (h <= base || eaten - h >= K)
+                H[e->type[i]] = ++eaten;
+        };
+
+        e->result[q] = eaten - base;
+        base = eaten;
+    };
+
+    free(H);
+}
+
+
+/*
+ * getMaximumEatenDishCount(N, D, K[q]) into result[q] for q = 0, ..., Q-1,
+ * on the given number of threads, or parallel_threads() if that is <= 0.
+ */
+void getMaximumEatenDishCountBatch(int N, int *D, int Q, const int *K, int *result,
+        int num_threads)
+{
+    long long *key;
+    int *type;
+    eaten_batch_t e = { .N = N, .Q = Q, .K = K, .result = result };
+
+    if (Q <= 0)
+        return;
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    num_threads = MAX(1, MIN(num_threads, Q));
+
+    key = malloc(2 * (size_t)N * sizeof *key);
+    e.type = type = malloc(N * sizeof *type);
+
+    for (int i = 0; i < N; i++)
+        key[i] = (long long)D[i] << 32 | i;
+    radix_sort_ll(key, N, key + N);
+    for (int i = 0; i < N; i++) {
+        if (i > 0 && key[i] >> 32 != key[i-1] >> 32)
+            e.T++;
+        type[key[i] & 0xffffffff] = e.T;
+    };
+    e.T++;
+    free(key);
+
+    parallel_run(num_threads, eaten_batch_worker, &e);
+
+    free(type);
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getMaximumEatenDishCount(6, (int []){1,2,3,3,2,1}, 1), 5);
@@ -52,5 +301,137 @@ int main(int argc, char **argv) {
         getMaximumEatenDishCount(6, (int []){1,2,3,3,2,1}, 2), 4);
     printf("result = %d, expected = %d\n",
         getMaximumEatenDishCount(7, (int []){1,2,1,2,1,2,1}, 2), 2);
+
+    // one belt reused for random runs over the whole int range, checked
+    // against a scan of the last K dishes eaten
+    int D[2000], eaten[2000], errors = 0;
+    belt_t *b = belt_new(1);
+    srand(1);
+    for (int t = 0; t < 200; t++) {
+        int N = rand() % 2000 + 1, K = rand() % N + 1, types = rand() % 100 + 1, n = 0;
+
+        for (int i = 0; i < N; i++)
+            D[i] = (int)(2654435761u * (unsigned)(rand() % types));
+        belt_reset(b, K);
+        for (int i = 0; i < N; i++) {
+            int fresh = 1;
+
+            for (int j = MAX(0, n-K); j < n; j++)
+                fresh &= eaten[j] != D[i];
+            if (fresh)
+                eaten[n++] = D[i];
+            errors += belt_push(b, D[i]) != fresh;
+        };
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // far more dishes eaten than K, the ring wrapping round many times
+    errors = 0;
+    belt_reset(b, 3);
+    for (int i = 0, n = 0; i < 1000000; i++) {
+        int dish = rand() % 5, fresh = 1;
+
+        for (int j = 0; j < MIN(n, 3); j++)
+            fresh &= eaten[j] != dish;
+        if (fresh)
+            eaten[n++ % 3] = dish;
+        errors += belt_push(b, dish) != fresh;
+    };
+    belt_delete(b);
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // every K at once, on a few threads, against one call per K
+    int K[2000], count[2000];
+    for (int i = 0; i < 2000; i++)
+        D[i] = rand() % 300 + 1, K[i] = i+1;
+    getMaximumEatenDishCountBatch(2000, D, 2000, K, count, 3);
+    errors = 0;
+    for (int i = 0; i < 2000; i++)
+        errors += count[i] != getMaximumEatenDishCount(2000, D, K[i]);
+
+    // no K at all, leaving the results alone
+    count[0] = -1;
+    getMaximumEatenDishCountBatch(2000, D, 0, K, count, 3);
+    errors += count[0] != -1;
+    printf("result = %d, expected = %d\n", errors, 0);
+}
+
+#else
+
+int beltRun(belt_t *b, int N, int *D, int K) {
+    int eaten = 0;
+
+    belt_reset(b, K);
+    for (int i = 0; i < N; i++)
+        eaten += belt_push(b, D[i]);
+
+    return eaten;
+}
+
+
+/*
+ * The Q runs one call at a time, returning the total eaten as a checksum.
+ */
+long long repeatMaximumEatenDishCount(int N, int *D, int Q, int *K, int *result) {
+    long long total = 0;
+
+    for (int q = 0; q < Q; q++)
+        total += result[q] = getMaximumEatenDishCount(N, D, K[q]);
+
+    return total;
+}
+
+
+long long batchMaximumEatenDishCount(int N, int *D, int Q, int *K, int *result) {
+    long long total = 0;
+
+    getMaximumEatenDishCountBatch(N, D, Q, K, result, 0);
+    for (int q = 0; q < Q; q++)
+        total += result[q];
+
+    return total;
+}
+
+
+int main(int argc, char **argv) {
+    int N = 500000;
+    int *D = malloc(N * sizeof *D);
+    int K;
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        D[i] = bench_range(1, MAX_DISHES);
+    K = bench_range(1, N);
+    BENCH_CASE("random", N, 5, , getMaximumEatenDishCount(N, D, K));
+
+    BENCH_CASE("k-max", N, 5, , getMaximumEatenDishCount(N, D, N));
+
+    // the same runs on one belt, reused between runs
+    belt_t *b = belt_new(1);
+    BENCH_CASE("belt-random", N, 5, , beltRun(b, N, D, K));
+    BENCH_CASE("belt-k-max", N, 5, , beltRun(b, N, D, N));
+    BENCH_CASE("belt-k100", N, 5, , beltRun(b, N, D, 100));
+
+    // 256 values of K spread over [1,N] on the same belt, n counting every
+    // dish of every run
+    int Q = 256, *Ks = malloc(Q * sizeof *Ks), *count = malloc(Q * sizeof *count);
+    for (int q = 0; q < Q; q++)
+        Ks[q] = (long long)N * (q+1) / Q;
+    BENCH_CASE("all-k-calls", (long long)Q*N, 1, , repeatMaximumEatenDishCount(N, D, Q, Ks, count));
+    BENCH_CASE("all-k-batch", (long long)Q*N, 1, ,
+        batchMaximumEatenDishCount(N, D, Q, Ks, count));
+    free(count);
+    free(Ks);
+
+    // few dish types, so most dishes are skipped
+    bench_seed(2);
+    for (int i = 0; i < N; i++)
+        D[i] = bench_range(1, 100);
+    BENCH_CASE("few-types", N, 5, , getMaximumEatenDishCount(N, D, 50));
+    BENCH_CASE("belt-few-types", N, 5, , beltRun(b, N, D, 50));
+    belt_delete(b);
+
+    free(D);
 }
 
+#endif
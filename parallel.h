@@ -0,0 +1,74 @@
+/*
+ * Thread helpers shared by the puzzle programs.
+ *
+ * Parallel solvers take a thread count argument, where a value <= 0 selects
+ * parallel_threads(): the PUZZLE_THREADS environment variable if it is set,
+ * and the number of online processors otherwise.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+
+typedef void parallel_fn_t(void *arg, int thread, int num_threads);
+
+
+typedef struct parallel_job {
+    parallel_fn_t *fn;
+    void *arg;
+    int thread, num_threads;
+} parallel_job_t;
+
+
+static inline int parallel_threads(void) {
+    const char *s = getenv("PUZZLE_THREADS");
+    long n = s ? atol(s) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? n : 1;
+}
+
+
+static inline void *parallel_start(void *job) {
+    parallel_job_t *j = job;
+
+    j->fn(j->arg, j->thread, j->num_threads);
+    return NULL;
+}
+
+
+/*
+ * Call fn(arg, t, num_threads) for t = 0, ..., num_threads-1 on as many
+ * threads and wait for all of them to return.  The calling thread runs t = 0.
+ */
+static inline void parallel_run(int num_threads, parallel_fn_t *fn, void *arg) {
+    pthread_t thread[num_threads];
+    parallel_job_t job[num_threads];
+
+    for (int t = 0; t < num_threads; t++)
+        job[t] = (parallel_job_t){ fn, arg, t, num_threads };
+
+    for (int t = 1; t < num_threads; t++)
+        pthread_create(&thread[t], NULL, parallel_start, &job[t]);
+    fn(arg, 0, num_threads);
+    for (int t = 1; t < num_threads; t++)
+        pthread_join(thread[t], NULL);
+}
+
+
+/*
+ * Part t of [0,n) split into num_parts contiguous pieces of nearly equal
+ * size.
+ */
+static inline void parallel_range(long long n, int t, int num_parts,
+        long long *lo, long long *hi)
+{
+    *lo = n * t / num_parts;
+    *hi = n * (t+1) / num_parts;
+}
+
+
+#endif
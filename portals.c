@@ -51,122 +51,654 @@
  * G = {"xS..x..Ex"}    -> result = 3
  */
 
+/*
+ * Solution
+ *
+ * Every action takes one second, so a breadth-first search from the start
+ * finds the shortest route.  Walking adds the up to four neighbours of a
+ * cell, and the first time any portal marked with some letter is reached,
+ * every portal with that letter is added at once.  Later portals with the
+ * same letter can skip that, as everything they lead to has been reached
+ * already at no greater time.  Every cell is then queued at most once and
+ * every letter expanded once, which is O(R*C + 26).  The portals are
+ * bucketed by letter beforehand, so expanding a letter touches only its
+ * own portals.
+ */
+
+#include <immintrin.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include "grid.h"
+#include "parallel.h"
+
+#ifdef BENCH
+#include "bench.h"
+#endif
 
 
 #define MAX_ROWS        50
 #define MAX_COLS        50
 
-#define MAX_EXITS       (MAX_ROWS*MAX_COLS)
-#define MAX_PORTALS     (MAX_ROWS*MAX_COLS)
+#define IS_PORTAL(x)    ( (x) >= 'a' && (x) <= 'z' )
 
+// distances of cells not reached (yet) and of walls
+#define UNSEEN          (-1)
+#define WALL            (-2)
 
-#define PORTAL_BIT(x)   ( 1 << ((x)-'a') )
+#define MIN(x,y)        ( (x) < (y) ? (x) : (y) )
+#define MAX(x,y)        ( (x) > (y) ? (x) : (y) )
 
 
 typedef struct {
     // the given map
     int rows, cols;
-    char **map;
-    // minimum cost to reach position
-    unsigned **cost;
-    // starting coordinates
-    int start_row, start_col;
-    // number and coordinates of exits
-    int exits;
-    int exit_row[MAX_EXITS], exit_col[MAX_EXITS];
-    // number, coordinates, and char of portals
-    int portals;
-    int portal_row[MAX_PORTALS], portal_col[MAX_PORTALS];
-    char portal_chr[MAX_PORTALS];
+    const grid_t *grid;
+    // starting cell, as row*cols + col
+    int start;
+    // cells of the portals marked 'a'+x are portal[first_portal[x]..first_portal[x+1])
+    int first_portal[27];
+    int *portal;
 } map_info_t;
 
 
-void map_costs(map_info_t *mi, int row, int col, unsigned cost, int portals_used) {
-    if (cost >= mi->cost[row][col] || mi->map[row][col] == '#')
-        return;
+void map_info_init(map_info_t *mi, const grid_t *g) {
+    int R = g->rows, C = g->cols, count[27] = { 0 };
 
-    mi->cost[row][col] = cost++;
+    mi->rows = R;
+    mi->cols = C;
+    mi->grid = g;
+    mi->start = -1;
 
-    // no reason to go past an exit
-    if (mi->map[row][col] == 'E')
-        return;
+    for (int i = 0; i < R; i++) {
+        const char *row = grid_row(g, i);
+
+        for (int j = 0; j < C; j++) {
+            if (row[j] == 'S')
+                mi->start = i*C + j;
+            else if (IS_PORTAL(row[j]))
+                count[row[j]-'a'+1]++;
+        };
+    };
+
+    mi->first_portal[0] = 0;
+    for (int x = 1; x <= 26; x++)
+        mi->first_portal[x] = count[x] += mi->first_portal[x-1];
+
+    mi->portal = malloc(MAX(1, count[26]) * sizeof *mi->portal);
+    for (int i = 0; i < R; i++) {
+        const char *row = grid_row(g, i);
+
+        for (int j = 0; j < C; j++)
+            if (IS_PORTAL(row[j]))
+                mi->portal[count[row[j]-'a']++] = i*C + j;
+    };
+}
+
+
+void map_info_free(map_info_t *mi) {
+    free(mi->portal);
+}
+
+
+/*
+ * Distances with every cell unseen and every wall marked as such, so that
+ * walls are never visited.
+ */
+void map_clear_dist(map_info_t *mi, int *dist) {
+    for (int i = 0; i < mi->rows; i++) {
+        const char *row = grid_row(mi->grid, i);
+
+        for (int j = 0; j < mi->cols; j++)
+            dist[i*mi->cols + j] = row[j] == '#' ? WALL : UNSEEN;
+    };
+}
+
+
+/*
+ * Breadth-first search from the cells queue[0..tail), whose distances must
+ * be set already.  With stop_at_exit the search ends at the first exit and
+ * returns its distance; otherwise, or if there is no exit in reach, it
+ * returns -1 once every reachable cell has its distance.  dist and queue
+ * need room for rows*cols cells.
+ */
+int map_search(map_info_t *mi, int *dist, int *queue, int tail, int stop_at_exit) {
+    int R = mi->rows, C = mi->cols;
+    int head = 0, fired = 0;
+
+    while (head < tail) {
+        int c = queue[head++], i = c / C, j = c % C, d = dist[c] + 1;
+        int next[4], n = 0;
+        char x = grid_row(mi->grid, i)[j];
+
+        if (x == 'E' && stop_at_exit)
+            return dist[c];
 
-    // no route should go through the same portal type twice
-    if (mi->map[row][col] >= 'a' && mi->map[row][col] <= 'z' &&
-        !(portals_used & PORTAL_BIT(mi->map[row][col])))
-    {
-        for (int i = 0; i < mi->portals; i++) {
-            if (mi->portal_chr[i] == mi->map[row][col]) {
-                map_costs(mi, mi->portal_row[i], mi->portal_col[i], cost, \
-                    portals_used | PORTAL_BIT(mi->map[row][col]));
+        if (i > 0)   next[n++] = c-C;
+        if (j > 0)   next[n++] = c-1;
+        if (i+1 < R) next[n++] = c+C;
+        if (j+1 < C) next[n++] = c+1;
+
+        for (int k = 0; k < n; k++) {
+            if (dist[next[k]] == UNSEEN) {
+                dist[next[k]] = d;
+                queue[tail++] = next[k];
+            };
+        };
+
+        if (IS_PORTAL(x) && !(fired & 1 << (x-'a'))) {
+            fired |= 1 << (x-'a');
+            for (int p = mi->first_portal[x-'a']; p < mi->first_portal[x-'a'+1]; p++) {
+                if (dist[mi->portal[p]] == UNSEEN) {
+                    dist[mi->portal[p]] = d;
+                    queue[tail++] = mi->portal[p];
+                };
             };
         };
     };
 
-    if (row > 0)
-        map_costs(mi, row-1, col, cost, portals_used);
-    if (col > 0)
-        map_costs(mi, row, col-1, cost, portals_used);
-    if (row+1 < mi->rows)
-        map_costs(mi, row+1, col, cost, portals_used);
-    if (col+1 < mi->cols)
-        map_costs(mi, row, col+1, cost, portals_used);
+    return -1;
+}
+
+
+/*
+ * Same as getSecondsRequired() for a grid mapped or wrapped by grid.h.
+ */
+int getSecondsRequiredGrid(const grid_t *g) {
+    int R = g->rows, C = g->cols, result;
+    int *dist = malloc(2 * (size_t)R*C * sizeof *dist);
+    map_info_t mi;
+
+    map_info_init(&mi, g);
+    map_clear_dist(&mi, dist);
+    dist[mi.start] = 0;
+    dist[R*C] = mi.start;
+    result = map_search(&mi, dist, dist + R*C, 1, 1);
+    map_info_free(&mi);
+    free(dist);
+
+    return result;
 }
 
 
 int getSecondsRequired(int R, int C, char **G) {
-    map_info_t mi = {
-        .rows = R, .cols = C, .map = G,
-        .exits = 0, .portals = 0,
-    };
+    grid_t g;
+    int result;
+
+    grid_wrap(&g, R, C, G);
+    result = getSecondsRequiredGrid(&g);
+    grid_free(&g);
+
+    return result;
+}
+
+
+/*
+ * Distances to the nearest exit from every cell.
+ *
+ * Walking and teleporting can both be undone in one second, so the distance
+ * from a cell to the nearest exit is the distance from the nearest exit to
+ * the cell, and a single breadth-first search started from all the exits at
+ * once finds it for every cell.  The portals of a letter are expanded
+ * together as in the forward search, which is what a virtual node per
+ * letter would do.  Queries are then a single lookup.
+ */
+
+typedef struct portal_oracle {
+    int rows, cols;
+    int *dist;                      // [rows*cols] seconds to an exit, or < 0
+} portal_oracle_t;
 
-    // find start & make lists of exits and portals
+
+portal_oracle_t *portal_oracle_new(int R, int C, char **G) {
+    portal_oracle_t *o = malloc(sizeof *o);
+    int *queue = malloc((size_t)R*C * sizeof *queue), tail = 0;
+    map_info_t mi;
+    grid_t g;
+
+    o->rows = R;
+    o->cols = C;
+    o->dist = malloc((size_t)R*C * sizeof *o->dist);
+
+    grid_wrap(&g, R, C, G);
+    map_info_init(&mi, &g);
+    map_clear_dist(&mi, o->dist);
     for (int i = 0; i < R; i++) {
         for (int j = 0; j < C; j++) {
-            if (G[i][j] == 'S') {
-                mi.start_row = i;
-                mi.start_col = j;
-            } else if (G[i][j] == 'E') {
-                mi.exit_row[mi.exits] = i;
-                mi.exit_col[mi.exits] = j;
-                mi.exits++;
-            } else if (G[i][j] >= 'a' && G[i][j] <= 'z') {
-                mi.portal_row[mi.portals] = i;
-                mi.portal_col[mi.portals] = j;
-                mi.portal_chr[mi.portals] = G[i][j];
-                mi.portals++;
+            if (G[i][j] == 'E') {
+                o->dist[i*C + j] = 0;
+                queue[tail++] = i*C + j;
             };
         };
     };
+    map_search(&mi, o->dist, queue, tail, 0);
+    map_info_free(&mi);
+    grid_free(&g);
+    free(queue);
 
-    // initialize cost map
-    unsigned *linear_cost = malloc(R*C * sizeof *linear_cost);
-    unsigned *cost[R];
+    return o;
+}
 
-    for (int i = 0; i < R; i++) {
-        cost[i] = linear_cost + i * (C * sizeof *linear_cost);
-        for (int j = 0; j < C; j++) {
-            cost[i][j] = UINT_MAX;
+
+void portal_oracle_delete(portal_oracle_t *o) {
+    if (!o)
+        return;
+
+    free(o->dist);
+    free(o);
+}
+
+
+/*
+ * Seconds required from the cell in the given row and column, or -1 if no
+ * exit can be reached from there (or it is a wall).
+ */
+int portal_oracle_query(const portal_oracle_t *o, int row, int col) {
+    return MAX(-1, o->dist[row*o->cols + col]);
+}
+
+
+/*
+ * Bitboard search for very large grids.
+ *
+ * Each row of the grid is a row of 64-bit words, one bit per cell, in three
+ * bitboards: the open cells not reached yet (walls are never open), the
+ * frontier of cells reached at the current distance, and the exits and
+ * portals.  A frontier word f reaches the cells f << 1 and f >> 1 of its
+ * own word, f of the words above and below it, and the carries f << 63 and
+ * f >> 63 of the words left and right of it, in so far as they are open.
+ *
+ * A search wave crosses most rows at only a few places, so sweeping whole
+ * rows would mostly shift zeros.  Instead the nonzero frontier words are
+ * kept in a list.  A level takes their values out of the frontier bitboard
+ * and then ORs what each of them reaches back into it, listing every word
+ * that turns nonzero, which makes the list for the next level.  Frontier
+ * words meeting the exits and portals are looked at bit by bit, and the
+ * first portal of a letter found adds the others to the next frontier.
+ *
+ * The bitboards are packed from the text 32 cells at a time with AVX2
+ * compares where available.  Memory is three bits per cell, plus lists as
+ * long as the frontier.
+ */
+
+typedef struct bitgrid {
+    int rows, cols, words;          // words per row
+    const grid_t *grid;
+    uint64_t *open;                 // [rows*words] open cells not reached yet
+    uint64_t *frontier;             // [rows*words] cells at the current distance
+    uint64_t *special;              // [rows*words] exits and portals
+    size_t *active, num_active;     // frontier words
+    uint64_t *value;                // their values
+    size_t *next;                   // frontier words of the next level
+    size_t max_words;               // room in active, value, and next
+    long long first_portal[27];
+    long long *portal;              // portal cells by letter, as row*cols + col
+} bitgrid_t;
+
+
+/*
+ * Set the bits of the open cells and of the exits and portals in a row of
+ * n cells.  open and special must be zero.
+ */
+void bitgrid_pack_row(const char *row, int n, uint64_t *open, uint64_t *special) {
+    for (int j = 0; j < n; j++) {
+        open[j/64] |= (uint64_t)(row[j] != '#') << j%64;
+        special[j/64] |= (uint64_t)(row[j] == 'E' || IS_PORTAL(row[j])) << j%64;
+    };
+}
+
+
+__attribute__((target("avx2")))
+void bitgrid_pack_row_avx2(const char *row, int n, uint64_t *open, uint64_t *special) {
+    const __m256i wall = _mm256_set1_epi8('#'), exit = _mm256_set1_epi8('E');
+    const __m256i a = _mm256_set1_epi8('a'), z = _mm256_set1_epi8('z');
+    int j;
+
+    // 32 cells at a time into the low or high half of a word
+    for (j = 0; j+32 <= n; j += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(row+j));
+        __m256i portal = _mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_max_epu8(x, a), z), x);
+        uint32_t walls = _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, wall));
+        uint32_t specials = _mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, exit), portal));
+
+        open[j/64] |= (uint64_t)~walls << j%64;
+        special[j/64] |= (uint64_t)specials << j%64;
+    };
+
+    for (; j < n; j++) {
+        open[j/64] |= (uint64_t)(row[j] != '#') << j%64;
+        special[j/64] |= (uint64_t)(row[j] == 'E' || IS_PORTAL(row[j])) << j%64;
+    };
+}
+
+
+bitgrid_t *bitgrid_new(const grid_t *G) {
+    bitgrid_t *g = calloc(1, sizeof *g);
+    long long count[27] = { 0 };
+    int R = G->rows, C = G->cols, W = (C + 63) / 64;
+    void (*pack_row)(const char *row, int n, uint64_t *open, uint64_t *special) =
+        __builtin_cpu_supports("avx2") ? bitgrid_pack_row_avx2 : bitgrid_pack_row;
+
+    g->rows = R;
+    g->cols = C;
+    g->words = W;
+    g->grid = G;
+    g->open = calloc((size_t)R*W, sizeof *g->open);
+    g->frontier = calloc((size_t)R*W, sizeof *g->frontier);
+    g->special = calloc((size_t)R*W, sizeof *g->special);
+
+    for (int i = 0; i < R; i++)
+        pack_row(grid_row(G, i), C, g->open + (size_t)i*W, g->special + (size_t)i*W);
+
+    // portals by letter, from the exits and portals bitboard
+    for (int pass = 0; pass < 2; pass++) {
+        for (size_t w = 0; w < (size_t)R*W; w++) {
+            for (uint64_t x = g->special[w]; x; x &= x-1) {
+                int i = w / W, j = 64 * (w % W) + __builtin_ctzll(x);
+                char c = grid_row(G, i)[j];
+
+                if (!IS_PORTAL(c))
+                    continue;
+                if (pass == 0)
+                    count[c-'a'+1]++;
+                else
+                    g->portal[count[c-'a']++] = (long long)i*C + j;
+            };
+        };
+
+        if (pass == 0) {
+            g->first_portal[0] = 0;
+            for (int x = 1; x <= 26; x++)
+                g->first_portal[x] = count[x] += g->first_portal[x-1];
+            g->portal = malloc(MAX(1, count[26]) * sizeof *g->portal);
         };
     };
-    mi.cost = &cost[0];
 
-    // call recursive cost map function
-    map_costs(&mi, mi.start_row, mi.start_col, 0, 0);
+    return g;
+}
 
-    // loop over exits and choose the closest one
-    unsigned min_cost = UINT_MAX;
-    for (int i = 0; i < mi.exits; i++)
-        if (cost[mi.exit_row[i]][mi.exit_col[i]] < min_cost)
-            min_cost = cost[mi.exit_row[i]][mi.exit_col[i]];
 
-    return min_cost;
+void bitgrid_delete(bitgrid_t *g) {
+    if (!g)
+        return;
+
+    free(g->open);
+    free(g->frontier);
+    free(g->special);
+    free(g->active);
+    free(g->value);
+    free(g->next);
+    free(g->portal);
+    free(g);
+}
+
+
+/*
+ * Make room for n words in the frontier lists.
+ */
+static void bitgrid_reserve(bitgrid_t *g, size_t n) {
+    if (n <= g->max_words)
+        return;
+
+    g->max_words = MAX(n, 2*g->max_words);
+    g->active = realloc(g->active, g->max_words * sizeof *g->active);
+    g->value = realloc(g->value, g->max_words * sizeof *g->value);
+    g->next = realloc(g->next, g->max_words * sizeof *g->next);
 }
 
 
+/*
+ * OR the open cells of bits into frontier word w, listing it if it was zero.
+ */
+static inline void bitgrid_reach(bitgrid_t *g, size_t w, uint64_t bits) {
+    bits &= g->open[w];
+    if (!bits)
+        return;
+
+    if (!g->frontier[w])
+        g->next[g->num_active++] = w;
+    g->frontier[w] |= bits;
+}
+
+
+/*
+ * Same as map_search() from the start on the bitboards; the search uses up
+ * the grid, so it can only be run once.
+ */
+int bitgrid_search(bitgrid_t *g) {
+    size_t W = g->words, size = (size_t)g->rows * W, *swap;
+    uint64_t *F = g->frontier;
+    int fired = 0;
+
+    bitgrid_reserve(g, 64);
+    g->num_active = 0;
+    for (int i = 0; i < g->rows; i++)
+        for (int j = 0; j < g->cols; j++)
+            if (grid_row(g->grid, i)[j] == 'S')
+                bitgrid_reach(g, (size_t)i*W + j/64, (uint64_t)1 << j%64);
+
+    for (int d = 0; g->num_active > 0; d++) {
+        size_t num_active = g->num_active;
+        int newly_fired = 0;
+
+        // the words reached last level become the frontier
+        swap = g->active, g->active = g->next, g->next = swap;
+        bitgrid_reserve(g, 5 * num_active);
+        for (size_t a = 0; a < num_active; a++) {
+            size_t w = g->active[a];
+
+            g->open[w] &= ~F[w];
+            g->value[a] = F[w];
+            F[w] = 0;
+        };
+
+        // exits and portals on it
+        for (size_t a = 0; a < num_active; a++) {
+            size_t w = g->active[a];
+            uint64_t x = g->value[a] & g->special[w];
+
+            for (; x; x &= x-1) {
+                char c = grid_row(g->grid, w / W)[64 * (w % W) + __builtin_ctzll(x)];
+
+                if (c == 'E')
+                    return d;
+                if (!(fired & 1 << (c-'a')))
+                    fired |= 1 << (c-'a'), newly_fired |= 1 << (c-'a');
+            };
+        };
+
+        // what it reaches
+        g->num_active = 0;
+        for (size_t a = 0; a < num_active; a++) {
+            size_t w = g->active[a], k = w % W;
+            uint64_t f = g->value[a];
+
+            bitgrid_reach(g, w, f << 1 | f >> 1);
+            if (w >= W)
+                bitgrid_reach(g, w-W, f);
+            if (w+W < size)
+                bitgrid_reach(g, w+W, f);
+            if (k > 0 && f & 1)
+                bitgrid_reach(g, w-1, f << 63);
+            if (k+1 < W && f >> 63)
+                bitgrid_reach(g, w+1, f >> 63);
+        };
+
+        // and where the portals of the letters found lead
+        for (int x = 0; newly_fired && x < 26; x++) {
+            if (!(newly_fired & 1 << x))
+                continue;
+            bitgrid_reserve(g, g->num_active + g->first_portal[x+1] - g->first_portal[x]);
+            for (long long p = g->first_portal[x]; p < g->first_portal[x+1]; p++) {
+                int i = g->portal[p] / g->cols, j = g->portal[p] % g->cols;
+
+                bitgrid_reach(g, (size_t)i*W + j/64, (uint64_t)1 << j%64);
+            };
+        };
+    };
+
+    return -1;
+}
+
+
+/*
+ * Same as getSecondsRequiredGrid() on the bitboards.
+ */
+int getSecondsRequiredBitboard(const grid_t *G) {
+    bitgrid_t *g = bitgrid_new(G);
+    int result = bitgrid_search(g);
+
+    bitgrid_delete(g);
+
+    return result;
+}
+
+
+/*
+ * Level-synchronous parallel search.
+ *
+ * The rows are split into one stripe per thread.  Every level the frontier
+ * is the concatenation, stripe by stripe, of the cells each thread found
+ * in that stripe during the previous level, which keeps it roughly in row
+ * order, and each thread expands an equal share of it.  A thread files
+ * the cells it reaches by stripe in buffers of its own, so no two threads
+ * ever append to the same buffer.  Cells are claimed with an atomic
+ * exchange on their seen flag, and letters with an atomic OR on the fired
+ * mask, so that every cell joins the frontier once and every letter fires
+ * once, from whichever thread gets there first.  The threads meet at a
+ * barrier after every level, so grids whose search runs through a long
+ * narrow passage gain nothing from more threads.
+ */
+
+typedef struct portal_bucket {
+    int *cell, size, max_size;
+} portal_bucket_t;
+
+
+typedef struct portal_bfs {
+    map_info_t mi;
+    unsigned char *seen;            // [rows*cols] walls and cells reached
+    int *stripe;                    // [rows] stripe of each row
+    int num_threads;
+    portal_bucket_t *bucket[2];     // [num_threads*num_threads] by stripe, then thread
+    int fired;
+    int found;                      // level the exit was found on, or -1
+    pthread_barrier_t barrier;
+} portal_bfs_t;
+
+
+static void portal_bfs_claim(portal_bfs_t *b, portal_bucket_t *next, int c) {
+    portal_bucket_t *q;
+
+    if (__atomic_load_n(&b->seen[c], __ATOMIC_RELAXED)
+            || __atomic_exchange_n(&b->seen[c], 1, __ATOMIC_RELAXED))
+        return;
+
+    q = &next[b->num_threads * b->stripe[c / b->mi.cols]];
+    if (q->size == q->max_size) {
+        q->max_size = 2*q->max_size + 64;
+        q->cell = realloc(q->cell, q->max_size * sizeof *q->cell);
+    };
+    q->cell[q->size++] = c;
+}
+
+
+void portal_bfs_worker(void *arg, int t, int num_threads) {
+    portal_bfs_t *b = arg;
+    int R = b->mi.rows, C = b->mi.cols;
+
+    for (int d = 0; ; d++) {
+        portal_bucket_t *cur = b->bucket[d % 2], *next = b->bucket[(d+1) % 2] + t;
+        long long total = 0, lo, hi, k = 0;
+
+        for (int s = 0; s < num_threads; s++)
+            next[s*num_threads].size = 0;
+        for (int q = 0; q < num_threads*num_threads; q++)
+            total += cur[q].size;
+        if (total == 0)
+            return;
+
+        // this thread's share, frontier[lo..hi)
+        parallel_range(total, t, num_threads, &lo, &hi);
+        for (int q = 0; q < num_threads*num_threads && k < hi; k += cur[q++].size) {
+            for (long long n = MAX(lo-k, 0); n < MIN(hi-k, cur[q].size); n++) {
+                int c = cur[q].cell[n], i = c / C, j = c % C, bit;
+                char x = grid_row(b->mi.grid, i)[j];
+
+                if (x == 'E') {
+                    __atomic_store_n(&b->found, d, __ATOMIC_RELAXED);
+                    break;
+                };
+
+                if (i > 0)   portal_bfs_claim(b, next, c-C);
+                if (j > 0)   portal_bfs_claim(b, next, c-1);
+                if (i+1 < R) portal_bfs_claim(b, next, c+C);
+                if (j+1 < C) portal_bfs_claim(b, next, c+1);
+
+                bit = IS_PORTAL(x) ? 1 << (x-'a') : 0;
+                if (bit && !(__atomic_load_n(&b->fired, __ATOMIC_RELAXED) & bit)
+                        && !(__atomic_fetch_or(&b->fired, bit, __ATOMIC_RELAXED) & bit))
+                    for (int p = b->mi.first_portal[x-'a']; p < b->mi.first_portal[x-'a'+1]; p++)
+                        portal_bfs_claim(b, next, b->mi.portal[p]);
+            };
+        };
+
+        // a thread out of the barrier first may find the exit one level on
+        pthread_barrier_wait(&b->barrier);
+        if (__atomic_load_n(&b->found, __ATOMIC_RELAXED) == d)
+            return;
+    };
+}
+
+
+/*
+ * Same as getSecondsRequiredGrid() on num_threads threads, or
+ * parallel_threads() if that is <= 0.
+ */
+int getSecondsRequiredParallel(const grid_t *g, int num_threads) {
+    portal_bfs_t b = { .found = -1 };
+    int R = g->rows, C = g->cols, T;
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    T = b.num_threads = MIN(num_threads, R);
+
+    map_info_init(&b.mi, g);
+    b.seen = malloc((size_t)R*C);
+    b.stripe = malloc(R * sizeof *b.stripe);
+    for (int i = 0; i < R; i++) {
+        const char *row = grid_row(g, i);
+
+        for (int j = 0; j < C; j++)
+            b.seen[i*C + j] = row[j] == '#';
+        b.stripe[i] = ((long long)(i+1) * T - 1) / R;
+    };
+    b.bucket[0] = calloc(T*T, sizeof *b.bucket[0]);
+    b.bucket[1] = calloc(T*T, sizeof *b.bucket[1]);
+    pthread_barrier_init(&b.barrier, NULL, T);
+
+    portal_bfs_claim(&b, b.bucket[0], b.mi.start);
+    parallel_run(T, portal_bfs_worker, &b);
+
+    pthread_barrier_destroy(&b.barrier);
+    for (int q = 0; q < T*T; q++)
+        free(b.bucket[0][q].cell), free(b.bucket[1][q].cell);
+    free(b.bucket[0]);
+    free(b.bucket[1]);
+    free(b.stripe);
+    free(b.seen);
+    map_info_free(&b.mi);
+
+    return b.found;
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getSecondsRequired(3, 3, (char *[]){".E.", ".#E", ".S#"}), 4);
@@ -176,5 +708,312 @@ int main(int argc, char **argv) {
         getSecondsRequired(3, 4, (char *[]){"aS.b", "####", "Eb.a"}), 4);
     printf("result = %d, expected = %d\n",
         getSecondsRequired(1, 9, (char *[]){"xS..x..Ex"}), 3);
+
+    // random small grids against relaxing every move until nothing changes
+    char cells[8*8], *G[8];
+    int dist[8*8], errors = 0;
+    srand(1);
+    for (int t = 0; t < 1000; t++) {
+        int R = rand() % 8 + 1, C = rand() % 8 + 1, changed = 1, best = INT_MAX;
+
+        for (int i = 0; i < R; i++)
+            G[i] = cells + i*C;
+        for (int c = 0; c < R*C; c++)
+            cells[c] = ".....##Eabc"[rand() % 11];
+        cells[rand() % (R*C)] = 'S';
+
+        for (int c = 0; c < R*C; c++)
+            dist[c] = cells[c] == 'S' ? 0 : INT_MAX;
+        while (changed) {
+            changed = 0;
+            for (int c = 0; c < R*C; c++) {
+                if (dist[c] == INT_MAX || cells[c] == '#' || cells[c] == 'E')
+                    continue;
+                for (int n = 0; n < R*C; n++) {
+                    int walk = (n == c-C || n == c+C || (n == c-1 && c%C > 0)
+                        || (n == c+1 && n%C > 0)) && cells[n] != '#';
+                    int teleport = n != c && IS_PORTAL(cells[c]) && cells[n] == cells[c];
+
+                    if ((walk || teleport) && dist[c] + 1 < dist[n])
+                        dist[n] = dist[c] + 1, changed = 1;
+                };
+            };
+        };
+        for (int c = 0; c < R*C; c++)
+            if (cells[c] == 'E')
+                best = MIN(best, dist[c]);
+
+        errors += getSecondsRequired(R, C, G) != (best == INT_MAX ? -1 : best);
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // the oracle against a search from every cell in turn
+    int queue[8*8];
+    errors = 0;
+    for (int t = 0; t < 200; t++) {
+        int R = rand() % 8 + 1, C = rand() % 8 + 1;
+        portal_oracle_t *o;
+        map_info_t mi;
+        grid_t g;
+
+        for (int i = 0; i < R; i++)
+            G[i] = cells + i*C;
+        for (int c = 0; c < R*C; c++)
+            cells[c] = ".....##Eabc"[rand() % 11];
+        o = portal_oracle_new(R, C, G);
+        grid_wrap(&g, R, C, G);
+        map_info_init(&mi, &g);
+
+        for (int c = 0; c < R*C; c++) {
+            int expected = -1;
+
+            map_clear_dist(&mi, dist);
+            if (dist[c] != WALL) {
+                dist[c] = 0, queue[0] = c;
+                expected = map_search(&mi, dist, queue, 1, 1);
+            };
+            errors += portal_oracle_query(o, c / C, c % C) != expected;
+        };
+        map_info_free(&mi);
+        grid_free(&g);
+        portal_oracle_delete(o);
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // the bitboard search against the queue, on grids several words wide
+    char *big = malloc(40*300), *B[40];
+    grid_t g;
+    errors = 0;
+    for (int t = 0; t < 500; t++) {
+        int R = rand() % 40 + 1, C = rand() % 300 + 1, walls = rand() % 60;
+
+        for (int i = 0; i < R; i++)
+            B[i] = big + i*C;
+        for (int c = 0; c < R*C; c++) {
+            int r = rand() % 1000;
+
+            big[c] = r < 10*walls ? '#' : r < 998 ? '.' : r == 998 ? 'E' : 'a' + rand() % 3;
+        };
+        big[rand() % (R*C)] = 'S';
+        grid_wrap(&g, R, C, B);
+        errors += getSecondsRequiredBitboard(&g) != getSecondsRequiredGrid(&g);
+        grid_free(&g);
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // and so does the parallel search, on more threads than rows too
+    errors = 0;
+    for (int t = 0; t < 200; t++) {
+        int R = rand() % 40 + 1, C = rand() % 300 + 1, walls = rand() % 60;
+
+        for (int i = 0; i < R; i++)
+            B[i] = big + i*C;
+        for (int c = 0; c < R*C; c++) {
+            int r = rand() % 1000;
+
+            big[c] = r < 10*walls ? '#' : r < 998 ? '.' : r == 998 ? 'E' : 'a' + rand() % 3;
+        };
+        big[rand() % (R*C)] = 'S';
+        grid_wrap(&g, R, C, B);
+        errors += getSecondsRequiredParallel(&g, t % 8 + 1) != getSecondsRequiredGrid(&g);
+        grid_free(&g);
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // the last grid through a text file and a binary one
+    char path[] = "/tmp/portals-XXXXXX", binary[] = "/tmp/portals-XXXXXX";
+    int R = 40, C = 300, expected = getSecondsRequired(R, C, B);
+    FILE *f = fdopen(mkstemp(path), "w");
+    grid_t h;
+    errors = 0;
+    for (int i = 0; i < R; i++)
+        fprintf(f, "%.*s%s", C, B[i], i+1 < R ? "\n" : "");
+    fclose(f);
+    errors += grid_open(&h, path) != 0 || h.rows != R || h.cols != C;
+    errors += getSecondsRequiredGrid(&h) != expected;
+    errors += getSecondsRequiredBitboard(&h) != expected;
+    close(mkstemp(binary));
+    errors += grid_save(&h, binary) != 0;
+    grid_free(&h);
+    errors += grid_open(&h, binary) != 0 || h.rows != R || h.cols != C;
+    errors += getSecondsRequiredParallel(&h, 3) != expected;
+    grid_free(&h);
+
+    // and a text file whose lines are uneven but add up to whole rows
+    f = fopen(path, "w");
+    for (int i = 0; i < R; i++) {
+        int len = i == 0 || i == R-1 ? C : i % 2 ? C-1 : C+1;
+        fprintf(f, "%.*s%s", len, big, i+1 < R ? "\n" : "");
+    };
+    fclose(f);
+    errors += grid_open(&h, path) != -1;
+    unlink(path);
+    unlink(binary);
+    free(big);
+    printf("result = %d, expected = %d\n", errors, 0);
+}
+
+#else
+
+/*
+ * Total of the seconds required from every open cell, by one search each.
+ */
+long long searchEveryStart(int R, int C, char **G) {
+    int *dist = malloc(2 * (size_t)R*C * sizeof *dist), *queue = dist + R*C;
+    long long total = 0;
+    map_info_t mi;
+    grid_t g;
+
+    grid_wrap(&g, R, C, G);
+    map_info_init(&mi, &g);
+    for (int c = 0; c < R*C; c++) {
+        map_clear_dist(&mi, dist);
+        if (dist[c] != WALL) {
+            dist[c] = 0, queue[0] = c;
+            total += map_search(&mi, dist, queue, 1, 1);
+        };
+    };
+    map_info_free(&mi);
+    grid_free(&g);
+    free(dist);
+
+    return total;
+}
+
+
+long long queryEveryStart(int R, int C, char **G) {
+    portal_oracle_t *o = portal_oracle_new(R, C, G);
+    long long total = 0;
+
+    for (int c = 0; c < R*C; c++)
+        if (G[c / C][c % C] != '#')
+            total += portal_oracle_query(o, c / C, c % C);
+    portal_oracle_delete(o);
+
+    return total;
+}
+
+
+/*
+ * R x C cells, a fifth of them walls, 52 portals, the start and an exit in
+ * opposite corners.  Returns the cells, owned by g.
+ */
+char *randomGrid(grid_t *g, int R, int C, int seed) {
+    char *cells = malloc((size_t)R*C);
+
+    bench_seed(seed);
+    for (size_t c = 0; c < (size_t)R*C; c++)
+        cells[c] = bench_rand() % 5 ? '.' : '#';
+    for (int i = 0; i < 52; i++)
+        cells[bench_range(0, R-1) * (size_t)C + bench_range(0, C-1)] = 'a' + i/2;
+    cells[0] = 'S', cells[(size_t)R*C - 1] = 'E';
+
+    *g = (grid_t){ .rows = R, .cols = C, .stride = C, .cells = cells, .base = cells };
+
+    return cells;
+}
+
+
+/*
+ * Map the grid saved at path and search it.
+ */
+int searchFile(const char *path) {
+    grid_t g;
+    int result;
+
+    if (grid_open(&g, path) != 0)
+        return -2;
+    result = getSecondsRequiredBitboard(&g);
+    grid_free(&g);
+
+    return result;
+}
+
+
+/*
+ * Map the grid saved at path and let it go again, without reading a cell.
+ */
+long long mapFile(const char *path) {
+    grid_t g;
+    long long cells;
+
+    if (grid_open(&g, path) != 0)
+        return -1;
+    cells = (long long)g.rows * g.cols;
+    grid_free(&g);
+
+    return cells;
+}
+
+
+int main(int argc, char **argv) {
+    int R = MAX_ROWS, C = MAX_COLS;
+    char *cells = malloc(R*C), *G[R];
+
+    for (int i = 0; i < R; i++)
+        G[i] = cells + i*C;
+
+    // no walls, start and exit in opposite corners, a few portals
+    bench_seed(1);
+    memset(cells, '.', R*C);
+    for (int i = 0; i < 20; i++)
+        G[bench_range(0, R-1)][bench_range(0, C-1)] = 'a' + bench_range(0, 25);
+    G[0][0] = 'S', G[R-1][C-1] = 'E';
+    BENCH_CASE("open", R*C, 3, , getSecondsRequired(R, C, G));
+
+    // a quarter walls, plenty of portals
+    bench_seed(2);
+    for (int i = 0; i < R*C; i++) {
+        int r = bench_range(0, 99);
+        cells[i] = r < 25 ? '#' : r < 30 ? 'a' + bench_range(0, 25) : '.';
+    };
+    G[0][0] = 'S', G[R-1][C-1] = 'E';
+    BENCH_CASE("random", R*C, 3, , getSecondsRequired(R, C, G));
+
+    // a search from every open cell, against the oracle and a lookup each
+    BENCH_CASE("every-start-search", R*C, 3, , searchEveryStart(R, C, G));
+    BENCH_CASE("every-start-oracle", R*C, 3, , queryEveryStart(R, C, G));
+
+    free(cells);
+
+    // grids far beyond the constraints, a fifth walls and a few portals
+    R = C = 4000;
+    grid_t H;
+    char *h = randomGrid(&H, R, C, 3);
+    BENCH_CASE("4000x4000-queue", (long long)R*C, 3, , getSecondsRequiredGrid(&H));
+    BENCH_CASE("4000x4000-bitboard", (long long)R*C, 3, , getSecondsRequiredBitboard(&H));
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        char name[64];
+
+        snprintf(name, sizeof name, "4000x4000-parallel-%d", threads);
+        BENCH_CASE(name, (long long)R*C, 3, , getSecondsRequiredParallel(&H, threads));
+    };
+
+    // the same grid from a file: only the mapping, which reads no cells
+    // yet, and then mapping and searching it
+    char path[] = "/tmp/portals-XXXXXX";
+    close(mkstemp(path));
+    grid_save(&H, path);
+    BENCH_CASE("4000x4000-file-mmap-only", (long long)R*C, 3, , mapFile(path));
+    BENCH_CASE("4000x4000-file-bitboard", (long long)R*C, 3, , searchFile(path));
+    unlink(path);
+
+    // a single corridor winding through every other row
+    for (int i = 0; i < R; i++)
+        for (int j = 0; j < C; j++)
+            h[i*C + j] = i % 2 == 0 || j == (i % 4 == 1 ? C-1 : 0) ? '.' : '#';
+    h[0] = 'S', h[R*C - 1] = 'E';
+    BENCH_CASE("4000x4000-corridor-queue", (long long)R*C, 1, , getSecondsRequiredGrid(&H));
+    BENCH_CASE("4000x4000-corridor-bitboard", (long long)R*C, 1, ,
+        getSecondsRequiredBitboard(&H));
+    grid_free(&H);
+
+    if (argc > 1 && strcmp(argv[1], "large") == 0) {
+        R = C = 20000;
+        randomGrid(&H, R, C, 4);
+        BENCH_CASE("20000x20000-bitboard", (long long)R*C, 1, , getSecondsRequiredBitboard(&H));
+        grid_free(&H);
+    };
 }
 
+#endif
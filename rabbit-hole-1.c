@@ -32,14 +32,78 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "parallel.h"
 
-int getMaxVisitableWebpages(int N, int *L) {
-    int *v = calloc(N, sizeof *v);  // keep track of pages visited
-    int *d = calloc(N, sizeof *d);  // record link depth from each page
+#ifdef BENCH
+#include "bench.h"
+#endif
+
+#define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
+#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
+
+
+/*
+ * Pages visitable from every page.
+ *
+ * A rabbit_hole_t keeps its buffers between runs, growing them when it is
+ * given more pages than before, so answering for many link graphs in turn
+ * allocates nothing once the largest has been seen.  The path stack is
+ * one of those buffers, on the heap, so there is no limit on the number
+ * of pages from the size of the C stack.  After a run depth[i] holds the
+ * number of pages visitable starting from page i+1.
+ */
+
+typedef struct rabbit_hole {
+    int N, max_N;
+    int *v;                         // [max_N] position on the path + 1, or 0
+    int *depth;                     // [max_N] pages visitable from each page
+    int *stack;                     // [max_N] path of unseen pages
+} rabbit_hole_t;
+
+
+rabbit_hole_t *rabbit_hole_new(void) {
+    return calloc(1, sizeof(rabbit_hole_t));
+}
+
+
+void rabbit_hole_delete(rabbit_hole_t *h) {
+    if (!h)
+        return;
+
+    free(h->stack);
+    free(h->depth);
+    free(h->v);
+    free(h);
+}
+
+
+static void rabbit_hole_reserve(rabbit_hole_t *h, int N) {
+    if (N > h->max_N) {
+        h->max_N = N;
+        free(h->v), free(h->depth), free(h->stack);
+        h->v = malloc(N * sizeof *h->v);
+        h->depth = malloc(N * sizeof *h->depth);
+        h->stack = malloc(N * sizeof *h->stack);
+    };
+    h->N = N;
+}
+
+
+/*
+ * Count the pages visitable from each of the pages 1..N with links L[0..N).
+ * Returns the maximum.
+ */
+int rabbit_hole_run(rabbit_hole_t *h, int N, const int *L) {
+    int *v, *d, *s;
     int D = 0;                      // max depth
-    int s[N], si;                   // stack to keep track of link path
-    int j, n;
+    int si, j, n;
+
+    rabbit_hole_reserve(h, N);
+    v = h->v, d = h->depth, s = h->stack;
+    memset(v, 0, N * sizeof *v);
+    memset(d, 0, N * sizeof *d);
 
     for (int i = 0; i < N; i++) {
         if (d[i] != 0)
@@ -74,13 +138,320 @@ int getMaxVisitableWebpages(int N, int *L) {
             D = d[i];
     };
 
-    free(d);
-    free(v);
+    return D;
+}
+
+
+/*
+ * Pages visitable starting from page 1 <= page <= N of the last run.
+ */
+int rabbit_hole_count(const rabbit_hole_t *h, int page) {
+    return h->depth[page-1];
+}
+
+
+int getMaxVisitableWebpages(int N, int *L) {
+    rabbit_hole_t *h = rabbit_hole_new();
+    int D = rabbit_hole_run(h, N, L);
+
+    rabbit_hole_delete(h);
 
     return D;
 }
 
 
+/*
+ * Parallel run.
+ *
+ * The pages off the loops are peeled off level by level as in Kahn's
+ * algorithm: first the pages no link leads to, then those whose incoming
+ * links all come from earlier levels.  Each thread takes a share of a
+ * level and claims a page for the next level by an atomic decrement of its
+ * count of links from unpeeled pages, so only the pages on loops are left
+ * over.  Each thread then walks the loops from the pages in its part of
+ * [0,N) that no walk has claimed yet, claiming pages with an atomic
+ * exchange, and stops at the first page claimed already.  That page
+ * always started another walk, so the walks are pieces of the loops, and
+ * the pieces are added up into the loop lengths.  Finally the levels are
+ * gone through in reverse, each page off the loops counting one more than
+ * the page it links to.
+ *
+ * Threads meet at a barrier after every level, except that runs of levels
+ * smaller than RABBIT_SERIAL_LEVEL pages, as along a long path, are done
+ * by one thread alone.
+ */
+
+#define RABBIT_SERIAL_LEVEL 4096
+#define RABBIT_BUFFER       1024
+
+
+typedef struct rabbit_piece {
+    int start, length;
+    int next;                       // page after the piece, starting another
+    int loop;                       // length of the whole loop
+} rabbit_piece_t;
+
+
+typedef struct rabbit_sweep {
+    int N;
+    const int *L;
+    int *indeg;                     // [N] links from unpeeled pages
+    int *d;                         // [N] pages visitable
+    int *order;                     // [N] pages off the loops, by level
+    int count[3];                   // pages added to order[] by each step
+    int begin, end;                 // level left by the last serial step
+    int *level, num_levels, max_levels;
+    rabbit_piece_t **piece;         // [num_threads] pieces walked by each thread
+    int *num_pieces, *first_piece;  // [num_threads]
+    int *max;                       // [num_threads] max pages visitable
+    pthread_barrier_t barrier;
+} rabbit_sweep_t;
+
+
+/*
+ * Append buf[0..n) to the pages order[base..] added by a step so far.
+ */
+static void rabbit_flush(rabbit_sweep_t *w, int step, int base, int *buf, int *n) {
+    int at = base + __atomic_fetch_add(&w->count[step % 3], *n, __ATOMIC_RELAXED);
+
+    memcpy(w->order + at, buf, *n * sizeof *buf);
+    *n = 0;
+}
+
+
+static void rabbit_push(rabbit_sweep_t *w, int step, int base, int *buf, int *n, int page) {
+    buf[(*n)++] = page;
+    if (*n == RABBIT_BUFFER)
+        rabbit_flush(w, step, base, buf, n);
+}
+
+
+// thread 0 only
+static void rabbit_add_level(rabbit_sweep_t *w, int begin) {
+    if (w->num_levels == w->max_levels) {
+        w->max_levels = 2*w->max_levels + 64;
+        w->level = realloc(w->level, w->max_levels * sizeof *w->level);
+    };
+    w->level[w->num_levels++] = begin;
+}
+
+
+/*
+ * The piece of the loop after p, once indeg[] of the first page of every
+ * piece holds its number.
+ */
+static rabbit_piece_t *rabbit_next_piece(rabbit_sweep_t *w, rabbit_piece_t *p) {
+    int id = w->indeg[p->next], u = 0;
+
+    while (id >= w->first_piece[u] + w->num_pieces[u])
+        u++;
+
+    return &w->piece[u][id - w->first_piece[u]];
+}
+
+
+static void rabbit_sweep_worker(void *arg, int t, int num_threads) {
+    rabbit_sweep_t *w = arg;
+    const int *L = w->L;
+    int *indeg = w->indeg, *d = w->d, *order = w->order;
+    int buf[RABBIT_BUFFER], n = 0, begin, end, step = 0, max = 0;
+    long long lo, hi, a, b;
+
+    parallel_range(w->N, t, num_threads, &lo, &hi);
+    memset(indeg + lo, 0, (hi-lo) * sizeof *indeg);
+    pthread_barrier_wait(&w->barrier);
+    for (long long i = lo; i < hi; i++)
+        __atomic_fetch_add(&indeg[L[i]-1], 1, __ATOMIC_RELAXED);
+    pthread_barrier_wait(&w->barrier);
+
+    /*
+     * The pages no link leads to, then level after level.  Step s counts
+     * the pages it adds in count[s % 3], which thread 0 clears two steps
+     * ahead, once every thread is past reading it.
+     */
+    for (long long i = lo; i < hi; i++)
+        if (indeg[i] == 0)
+            rabbit_push(w, step, 0, buf, &n, i);
+    rabbit_flush(w, step, 0, buf, &n);
+    pthread_barrier_wait(&w->barrier);
+
+    begin = 0, end = w->count[step++ % 3];
+    for (; begin < end; step++) {
+        if (t == 0)
+            w->count[(step+1) % 3] = 0;
+
+        if (end - begin < RABBIT_SERIAL_LEVEL) {
+            if (t == 0) {
+                int tail = end;
+
+                while (begin < end && end - begin < RABBIT_SERIAL_LEVEL) {
+                    rabbit_add_level(w, begin);
+                    for (int k = begin; k < end; k++)
+                        if (--indeg[L[order[k]]-1] == 0)
+                            order[tail++] = L[order[k]]-1;
+                    begin = end, end = tail;
+                };
+                w->begin = begin, w->end = end;
+            };
+            pthread_barrier_wait(&w->barrier);
+            begin = w->begin, end = w->end;
+            pthread_barrier_wait(&w->barrier);
+        } else {
+            if (t == 0)
+                rabbit_add_level(w, begin);
+            parallel_range(end - begin, t, num_threads, &a, &b);
+            for (long long k = begin+a; k < begin+b; k++) {
+                int page = L[order[k]]-1;
+
+                if (__atomic_sub_fetch(&indeg[page], 1, __ATOMIC_RELAXED) == 0)
+                    rabbit_push(w, step, end, buf, &n, page);
+            };
+            rabbit_flush(w, step, end, buf, &n);
+            pthread_barrier_wait(&w->barrier);
+            begin = end, end += w->count[step % 3];
+        };
+    };
+    if (t == 0)
+        rabbit_add_level(w, end);
+
+    // pieces of the loops, from the pages left over
+    rabbit_piece_t *piece = NULL;
+    int num_pieces = 0, max_pieces = 0;
+
+    for (long long i = lo; i < hi; i++) {
+        int length = 1, page;
+
+        if (__atomic_load_n(&indeg[i], __ATOMIC_RELAXED) == 0
+                || __atomic_exchange_n(&indeg[i], 0, __ATOMIC_RELAXED) == 0)
+            continue;
+        for (page = L[i]-1; __atomic_exchange_n(&indeg[page], 0, __ATOMIC_RELAXED) > 0; page = L[page]-1)
+            length++;
+
+        if (num_pieces == max_pieces) {
+            max_pieces = 2*max_pieces + 16;
+            piece = realloc(piece, max_pieces * sizeof *piece);
+        };
+        piece[num_pieces++] = (rabbit_piece_t){ i, length, page, 0 };
+    };
+    w->piece[t] = piece;
+    w->num_pieces[t] = num_pieces;
+    pthread_barrier_wait(&w->barrier);
+
+    // the loop lengths, finding the pieces by their first pages
+    if (t == 0) {
+        for (int u = 0, first = 0; u < num_threads; first += w->num_pieces[u++])
+            w->first_piece[u] = first;
+        for (int u = 0; u < num_threads; u++)
+            for (int k = 0; k < w->num_pieces[u]; k++)
+                indeg[w->piece[u][k].start] = w->first_piece[u] + k;
+        for (int u = 0; u < num_threads; u++) {
+            for (int k = 0; k < w->num_pieces[u]; k++) {
+                rabbit_piece_t *p = &w->piece[u][k], *q = p;
+                int loop = 0;
+
+                if (p->loop)
+                    continue;
+                do
+                    loop += q->length, q = rabbit_next_piece(w, q);
+                while (q != p);
+                do
+                    q->loop = loop, q = rabbit_next_piece(w, q);
+                while (q != p);
+            };
+        };
+    };
+    pthread_barrier_wait(&w->barrier);
+
+    for (int k = 0; k < num_pieces; k++) {
+        int page = piece[k].start;
+
+        for (int m = 0; m < piece[k].length; m++, page = L[page]-1)
+            d[page] = piece[k].loop;
+        if (piece[k].loop > max)
+            max = piece[k].loop;
+    };
+    pthread_barrier_wait(&w->barrier);
+    free(piece);
+
+    // the levels in reverse, those too small to share on thread 0 alone
+    for (int k = w->num_levels - 2; k >= 0; ) {
+        int first = k;
+
+        if (w->level[k+1] - w->level[k] < RABBIT_SERIAL_LEVEL) {
+            while (k >= 0 && w->level[k+1] - w->level[k] < RABBIT_SERIAL_LEVEL)
+                k--;
+            a = t == 0 ? w->level[k+1] : 0;
+            b = t == 0 ? w->level[first+1] : 0;
+        } else {
+            parallel_range(w->level[k+1] - w->level[k], t, num_threads, &a, &b);
+            a += w->level[k], b += w->level[k];
+            k--;
+        };
+
+        for (long long m = b-1; m >= a; m--) {
+            int page = order[m];
+
+            d[page] = d[L[page]-1] + 1;
+            if (d[page] > max)
+                max = d[page];
+        };
+        pthread_barrier_wait(&w->barrier);
+    };
+
+    w->max[t] = max;
+}
+
+
+/*
+ * Same as rabbit_hole_run() on num_threads threads, or parallel_threads()
+ * if that is <= 0.  The loop counts of the pages are reused for the
+ * numbers of incoming links and the path stack for the levels.
+ */
+int rabbit_hole_run_parallel(rabbit_hole_t *h, int N, const int *L, int num_threads) {
+    rabbit_sweep_t w = { .N = N, .L = L };
+    int D = 0;
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    num_threads = MAX(1, MIN(num_threads, N / RABBIT_BUFFER));
+
+    rabbit_hole_reserve(h, N);
+    w.indeg = h->v;
+    w.d = h->depth;
+    w.order = h->stack;
+    w.piece = malloc(num_threads * sizeof *w.piece);
+    w.num_pieces = malloc(num_threads * sizeof *w.num_pieces);
+    w.first_piece = malloc(num_threads * sizeof *w.first_piece);
+    w.max = malloc(num_threads * sizeof *w.max);
+    pthread_barrier_init(&w.barrier, NULL, num_threads);
+
+    parallel_run(num_threads, rabbit_sweep_worker, &w);
+    for (int t = 0; t < num_threads; t++)
+        D = MAX(D, w.max[t]);
+
+    pthread_barrier_destroy(&w.barrier);
+    free(w.max);
+    free(w.first_piece);
+    free(w.num_pieces);
+    free(w.piece);
+    free(w.level);
+
+    return D;
+}
+
+
+int getMaxVisitableWebpagesParallel(int N, int *L, int num_threads) {
+    rabbit_hole_t *h = rabbit_hole_new();
+    int D = rabbit_hole_run_parallel(h, N, L, num_threads);
+
+    rabbit_hole_delete(h);
+
+    return D;
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getMaxVisitableWebpages(4, (int []){4,1,2,1}), 4);
@@ -88,5 +459,119 @@ int main(int argc, char **argv) {
         getMaxVisitableWebpages(5, (int []){4,3,5,1,2}), 3);
     printf("result = %d, expected = %d\n",
         getMaxVisitableWebpages(5, (int []){2,4,2,2,3}), 4);
+
+    // the count from every page against following its links, reusing the
+    // buffers for graphs of every size
+    rabbit_hole_t *h = rabbit_hole_new();
+    int L[50], seen[50], errors = 0;
+    srand(1);
+    for (int t = 0; t < 1000; t++) {
+        int N = rand() % 49 + 2;
+
+        for (int i = 0; i < N; i++)
+            do L[i] = rand() % N + 1; while (L[i] == i+1);
+        rabbit_hole_run(h, N, L);
+
+        for (int i = 0; i < N; i++) {
+            int count = 0;
+
+            memset(seen, 0, sizeof seen);
+            for (int j = i; !seen[j]; j = L[j]-1)
+                seen[j] = 1, count++;
+            errors += rabbit_hole_count(h, i+1) != count;
+        };
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // the parallel run against the serial one on larger graphs: random
+    // links, a random permutation (only loops), and a path into a loop
+    rabbit_hole_t *p = rabbit_hole_new();
+    int M = 300000, *K = malloc(M * sizeof *K);
+    errors = 0;
+    for (int t = 0; t < 24; t++) {
+        int N = rand() % M + 2;
+
+        if (t % 3 == 0) {
+            for (int i = 0; i < N; i++)
+                do K[i] = rand() % N + 1; while (K[i] == i+1);
+        } else if (t % 3 == 1) {
+            for (int i = 0; i < N; i++)
+                K[i] = i+1;
+            for (int i = N-1; i > 0; i--) {
+                int j = rand() % (i+1), k = K[i];
+                K[i] = K[j], K[j] = k;
+            };
+            for (int i = 0; i < N; i++)
+                if (K[i] == i+1)
+                    K[i] = i+2 <= N ? i+2 : 1;
+        } else {
+            for (int i = 0; i < N; i++)
+                K[i] = i+2;
+            K[N-1] = rand() % (N-1) + 1;
+        };
+
+        errors += rabbit_hole_run_parallel(p, N, K, t % 8 + 1) != rabbit_hole_run(h, N, K);
+        for (int i = 1; i <= N; i++)
+            errors += rabbit_hole_count(p, i) != rabbit_hole_count(h, i);
+    };
+    free(K);
+    rabbit_hole_delete(p);
+    rabbit_hole_delete(h);
+    printf("result = %d, expected = %d\n", errors, 0);
+}
+
+#else
+
+int main(int argc, char **argv) {
+    int N = 500000;
+    int *L = malloc(N * sizeof *L);
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        do L[i] = bench_range(1, N); while (L[i] == i+1);
+    BENCH_CASE("random", N, 5, , getMaxVisitableWebpages(N, L));
+
+    // the same with the buffers of an earlier run
+    rabbit_hole_t *h = rabbit_hole_new();
+    rabbit_hole_run(h, N, L);
+    BENCH_CASE("random-reuse", N, 5, , rabbit_hole_run(h, N, L));
+    BENCH_CASE("random-parallel", N, 5, , rabbit_hole_run_parallel(h, N, L, 0));
+
+    // a single loop through all pages
+    bench_seed(0);
+    for (int i = 0; i < N; i++)
+        L[i] = (i+1) % N + 1;
+    BENCH_CASE("loop", N, 5, , getMaxVisitableWebpages(N, L));
+    BENCH_CASE("loop-parallel", N, 5, , rabbit_hole_run_parallel(h, N, L, 0));
+
+    // one long path leading into a two page loop
+    for (int i = 0; i < N; i++)
+        L[i] = i+2;
+    L[N-1] = N-1;
+    BENCH_CASE("path", N, 5, , getMaxVisitableWebpages(N, L));
+    BENCH_CASE("path-parallel", N, 5, , rabbit_hole_run_parallel(h, N, L, 0));
+
+    // a path far longer than a stack array of the pages would allow, and
+    // random links on a hundred million pages
+    if (argc > 1 && strcmp(argv[1], "large") == 0) {
+        N = 50000000;
+        L = realloc(L, N * sizeof *L);
+        for (int i = 0; i < N; i++)
+            L[i] = i+2;
+        L[N-1] = N-1;
+        BENCH_CASE("path-large", N, 1, , rabbit_hole_run(h, N, L));
+
+        N = 100000000;
+        L = realloc(L, N * sizeof *L);
+        bench_seed(2);
+        for (int i = 0; i < N; i++)
+            do L[i] = bench_range(1, N); while (L[i] == i+1);
+        BENCH_CASE("random-large", N, 1, , rabbit_hole_run(h, N, L));
+        BENCH_CASE("random-large-parallel", N, 1, , rabbit_hole_run_parallel(h, N, L, 0));
+    };
+
+    rabbit_hole_delete(h);
+    free(L);
 }
 
+#endif
@@ -53,8 +53,15 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <strings.h>
 
+#include "parallel.h"
+
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 #define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
 #define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
@@ -68,37 +75,151 @@ typedef struct graph {
 } graph_t;
 
 
-graph_t *graph_new(int num_vertices, int num_edges, int *source, int *target) {
+/*
+ * Adjacency lists built from an edge list on several threads.
+ *
+ * Every thread counts the edges of its slice of the list per source vertex
+ * in a histogram of its own, so no counter is shared.  The histograms are
+ * then turned into write positions by vertex ranges: across the threads
+ * for each vertex, and by a prefix sum over the vertex ranges for the
+ * start of each list.  Finally each thread scatters its slice to its own
+ * positions, so every list holds its edges in the order of the edge list,
+ * exactly as a single pass would.  The histograms take num_vertices ints
+ * per thread, so the number of threads is held to at most about twice the
+ * number of edges per vertex, and the histograms to about twice the size
+ * of the edge list.
+ */
+
+#define GRAPH_MIN_EDGES     65536   // edges per thread worth starting it for
+
+
+typedef struct graph_build {
+    graph_t *g;
+    const int *source, *target;     // [g->num_edges] ends of each edge
+    int base;                       // number of the first vertex in them
+    int *hist;                      // [num_threads][g->num_vertices]
+    long long *block;               // [num_threads] edges from each vertex range
+    pthread_barrier_t barrier;
+} graph_build_t;
+
+
+static int graph_build_threads(long long num_vertices, long long num_edges, int num_threads) {
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    num_threads = MIN(num_threads, num_edges / GRAPH_MIN_EDGES);
+    num_threads = MIN(num_threads, 1 + 2*num_edges / MAX(1, num_vertices));
+
+    return MAX(1, num_threads);
+}
+
+
+/*
+ * Number of edges in the lists of the vertex ranges before that of thread
+ * t, once every thread has stored the number for its own range in block[t].
+ */
+static long long graph_offsets(long long *block, pthread_barrier_t *barrier, int t) {
+    long long offset = 0;
+
+    pthread_barrier_wait(barrier);
+    for (int u = 0; u < t; u++)
+        offset += block[u];
+
+    return offset;
+}
+
+
+static void graph_build_worker(void *arg, int t, int num_threads) {
+    graph_build_t *b = arg;
+    graph_t *g = b->g;
+    int N = g->num_vertices, *hist = b->hist + (long long)t*N, *edge = g->edge[0];
+    long long lo, hi, offset, sum = 0;
+
+    // count the edges of each source in this slice
+    memset(hist, 0, N * sizeof *hist);
+    parallel_range(g->num_edges, t, num_threads, &lo, &hi);
+    for (long long j = lo; j < hi; j++)
+        hist[b->source[j] - b->base]++;
+    pthread_barrier_wait(&b->barrier);
+
+    // position of each slice within the list of each vertex
+    parallel_range(N, t, num_threads, &lo, &hi);
+    for (long long v = lo; v < hi; v++) {
+        int n = 0;
+
+        for (int u = 0; u < num_threads; u++) {
+            int c = b->hist[(long long)u*N + v];
+            b->hist[(long long)u*N + v] = n;
+            n += c;
+        };
+        g->num_edges_[v] = n;
+        sum += n;
+    };
+    b->block[t] = sum;
+
+    offset = graph_offsets(b->block, &b->barrier, t);
+    for (long long v = lo; v < hi; v++) {
+        g->edge[v] = edge + offset;
+        for (int u = 0; u < num_threads; u++)
+            b->hist[(long long)u*N + v] += offset;
+        offset += g->num_edges_[v];
+    };
+    pthread_barrier_wait(&b->barrier);
+
+    // fill in the edges
+    parallel_range(g->num_edges, t, num_threads, &lo, &hi);
+    for (long long j = lo; j < hi; j++)
+        edge[hist[b->source[j] - b->base]++] = b->target[j] - b->base;
+}
+
+
+/*
+ * Graph of num_vertices vertices with edges from source[j] to target[j]
+ * for j in [0,num_edges), the vertices numbered from base on, built on
+ * num_threads threads, or parallel_threads() if that is <= 0.
+ */
+graph_t *graph_build(int num_vertices, int num_edges, const int *source, const int *target,
+        int base, int num_threads)
+{
     graph_t *g = malloc(sizeof *g);
+    graph_build_t b = { .g = g, .source = source, .target = target, .base = base };
 
     g->num_vertices = num_vertices;
     g->num_edges = num_edges;
-
     g->weight = calloc(num_vertices, sizeof *g->weight);
-    g->num_edges_ = calloc(num_vertices, sizeof *g->num_edges_);
-
-    // count number of edges for each vertex
-    for (int j = 0; j < num_edges; j++)
-        g->num_edges_[source[j]-1]++;
-
-    // allocate space for edges
+    g->num_edges_ = malloc(num_vertices * sizeof *g->num_edges_);
     g->edge = malloc(num_vertices * sizeof *g->edge);
     g->edge[0] = malloc(num_edges * sizeof *g->edge[0]);
-    for (int i = 1; i < num_vertices; i++)
-        g->edge[i] = g->edge[i-1] + g->num_edges_[i-1];
 
-    // fill in the edges
-    int *I = calloc(num_vertices, sizeof *I);
-    for (int j = 0; j < num_edges; j++) {
-        int src = source[j]-1, tgt = target[j]-1;
-        g->edge[src][I[src]++] = tgt;
-    };
-    free(I);
+    num_threads = graph_build_threads(num_vertices, num_edges, num_threads);
+    b.hist = malloc((long long)num_threads * num_vertices * sizeof *b.hist);
+    b.block = malloc(num_threads * sizeof *b.block);
+    pthread_barrier_init(&b.barrier, NULL, num_threads);
+    parallel_run(num_threads, graph_build_worker, &b);
+    pthread_barrier_destroy(&b.barrier);
+
+    free(b.block);
+    free(b.hist);
 
     return g;
 }
 
 
+graph_t *graph_new(int num_vertices, int num_edges, int *source, int *target) {
+    return graph_build(num_vertices, num_edges, source, target, 1, 1);
+}
+
+
+/*
+ * Same as graph_new() on num_threads threads, or parallel_threads() if that
+ * is <= 0.
+ */
+graph_t *graph_new_parallel(int num_vertices, int num_edges, int *source, int *target,
+        int num_threads)
+{
+    return graph_build(num_vertices, num_edges, source, target, 1, num_threads);
+}
+
+
 void graph_delete(graph_t *g) {
     if (!g)
         return;
@@ -127,32 +248,267 @@ void graph_print(graph_t *g) {
 }
 
 
-void scc_find(graph_t *g, int v, int *np,
-        int *index, int *low_link, int *on_stack,
-        int *s, int *sip,
-        int *scc, int *num_sccp)
-{
-    index[v] = *np, low_link[v] = *np, (*np)++;
-    s[(*sip)++] = v, on_stack[v] = 1;
-
-    for (int j = 0; j < g->num_edges_[v]; j++) {
-        int w = g->edge[v][j];
-        if (!index[w]) {
-            scc_find(g, w, np, index, low_link, on_stack, s, sip, scc, num_sccp);
-            low_link[v] = MIN(low_link[v], low_link[w]);
-        } else if (on_stack[w]) {
-            low_link[v] = MIN(low_link[v], index[w]);
+/*
+ * Tarjan's algorithm without recursion.
+ *
+ * The depth-first search keeps its path in call[] instead of on the C
+ * stack, so graphs with paths of any length (a chain of N pages is N
+ * calls deep) can be reduced, and all the per-vertex state is packed into
+ * 8 bytes.  Everything is allocated once per reduction.
+ */
+
+typedef struct scc_state {
+    unsigned index;                 // order of discovery from 1, 0 if not yet
+    unsigned low_link : 31;
+    unsigned on_stack : 1;
+} scc_state_t;
+
+
+typedef struct scc_frame {
+    int v, j;                       // vertex and its next edge
+} scc_frame_t;
+
+
+typedef struct scc_search {
+    scc_state_t *state;             // [num_vertices]
+    int *stack, size;               // [num_vertices] vertices not in an SCC yet
+    scc_frame_t *call;              // [num_vertices] path of the search
+    unsigned n;                     // next index
+    int *scc, num_scc;              // [num_vertices] SCC of each vertex
+} scc_search_t;
+
+
+static void scc_visit(scc_search_t *t, int v) {
+    t->state[v] = (scc_state_t){ t->n, t->n, 1 };
+    t->n++;
+    t->stack[t->size++] = v;
+}
+
+
+void scc_find(graph_t *g, int root, scc_search_t *t) {
+    scc_state_t *st = t->state;
+    int depth = 0;
+
+    scc_visit(t, root);
+    t->call[0] = (scc_frame_t){ root, 0 };
+
+    while (depth >= 0) {
+        scc_frame_t *f = &t->call[depth];
+        int v = f->v;
+
+        if (f->j < g->num_edges_[v]) {
+            int w = g->edge[v][f->j++];
+            if (!st[w].index) {
+                scc_visit(t, w);
+                t->call[++depth] = (scc_frame_t){ w, 0 };
+            } else if (st[w].on_stack) {
+                st[v].low_link = MIN(st[v].low_link, st[w].index);
+            };
+            continue;
+        };
+
+        // done with v
+        if (st[v].low_link == st[v].index) {
+            int w;
+            do {
+                w = t->stack[--t->size], st[w].on_stack = 0;
+                t->scc[w] = t->num_scc;
+            } while (w != v);
+            t->num_scc++;
+        };
+
+        if (--depth >= 0) {
+            int u = t->call[depth].v;
+            st[u].low_link = MIN(st[u].low_link, st[v].low_link);
         };
     };
+}
 
-    if (low_link[v] == index[v]) {
-        int w;
-        do {
-            w = s[--(*sip)], on_stack[w] = 0;
-            scc[w] = *num_sccp;
-        } while (w != v);
-        (*num_sccp)++;
+
+/*
+ * Number the strongly connected components (SCC) formed by the vertices v
+ * with scc[v] < 0 from num_scc on, using Tarjan's algorithm, and set
+ * scc[v] to the number of the SCC of v.  The other vertices must be in
+ * SCCs found already, so the edges to them can be ignored.  Returns the
+ * new number of SCCs.
+ */
+int graph_scc_label(graph_t *g, int *scc, int num_scc) {
+    scc_search_t t = {
+        .state = calloc(g->num_vertices, sizeof *t.state),
+        .stack = malloc(g->num_vertices * sizeof *t.stack),
+        .call = malloc(g->num_vertices * sizeof *t.call),
+        .n = 1,
+        .scc = scc,
+        .num_scc = num_scc,
     };
+
+    // the search passes over vertices seen before and not on its stack
+    for (int i = 0; i < g->num_vertices; i++)
+        if (scc[i] >= 0)
+            t.state[i].index = 1;
+
+    for (int i = 0; i < g->num_vertices; i++) {
+        if (t.state[i].index)
+            continue;
+
+        scc_find(g, i, &t);
+    };
+    num_scc = t.num_scc;
+
+    free(t.state);
+    free(t.stack);
+    free(t.call);
+
+    return num_scc;
+}
+
+
+/*
+ * Condensation into the SCC graph.
+ *
+ * Every thread lists the edges between different SCCs from its range of
+ * vertices into its own part of one edge list, which graph_build() turns
+ * into adjacency lists.  Parallel edges, of which a large SCC collects
+ * many, are then dropped by sorting each list and keeping one of each
+ * target, so the longest path search only sees every SCC edge once.
+ */
+
+typedef struct graph_condense {
+    graph_t *g, *sccg;
+    const int *scc;                 // [g->num_vertices]
+    int *source, *target;           // [num_edges] edges between SCCs
+    int *weight;                    // [num_scc]
+    int *edge;                      // [num_edges] the lists without repeats
+    long long num_edges;
+    long long *block;               // [num_threads] edges from each vertex range
+    pthread_barrier_t barrier;
+} graph_condense_t;
+
+
+static void graph_condense_count(void *arg, int t, int num_threads) {
+    graph_condense_t *c = arg;
+    graph_t *g = c->g;
+    long long lo, hi, n = 0, offset;
+
+    parallel_range(g->num_vertices, t, num_threads, &lo, &hi);
+    for (long long i = lo; i < hi; i++) {
+        __atomic_fetch_add(&c->weight[c->scc[i]], 1, __ATOMIC_RELAXED);
+        for (int j = 0; j < g->num_edges_[i]; j++)
+            n += c->scc[i] != c->scc[g->edge[i][j]];
+    };
+    c->block[t] = n;
+
+    offset = graph_offsets(c->block, &c->barrier, t);
+    if (t == num_threads-1) {
+        c->num_edges = offset + n;
+        c->source = malloc(c->num_edges * sizeof *c->source);
+        c->target = malloc(c->num_edges * sizeof *c->target);
+    };
+    pthread_barrier_wait(&c->barrier);
+
+    for (long long i = lo; i < hi; i++) {
+        for (int j = 0; j < g->num_edges_[i]; j++) {
+            int src = c->scc[i], tgt = c->scc[g->edge[i][j]];
+            if (src != tgt)
+                c->source[offset] = src, c->target[offset++] = tgt;
+        };
+    };
+}
+
+
+static int int_cmp(const void *x, const void *y) {
+    int a = *(const int *)x, b = *(const int *)y;
+    return (a > b) - (a < b);
+}
+
+
+/*
+ * Sort a[0..n) and move one of each value to the front.  Returns the
+ * number of values.
+ */
+static int sort_unique(int *a, int n) {
+    int m = 0;
+
+    if (n < 32) {
+        for (int i = 1; i < n; i++) {
+            int x = a[i], k = i;
+            for (; k > 0 && a[k-1] > x; k--)
+                a[k] = a[k-1];
+            a[k] = x;
+        };
+    } else {
+        qsort(a, n, sizeof *a, int_cmp);
+    };
+
+    for (int i = 0; i < n; i++)
+        if (m == 0 || a[i] != a[m-1])
+            a[m++] = a[i];
+
+    return m;
+}
+
+
+static void graph_condense_unique(void *arg, int t, int num_threads) {
+    graph_condense_t *c = arg;
+    graph_t *sccg = c->sccg;
+    long long lo, hi, n = 0, offset;
+
+    parallel_range(sccg->num_vertices, t, num_threads, &lo, &hi);
+    for (long long v = lo; v < hi; v++)
+        n += sccg->num_edges_[v] = sort_unique(sccg->edge[v], sccg->num_edges_[v]);
+    c->block[t] = n;
+
+    offset = graph_offsets(c->block, &c->barrier, t);
+    if (t == num_threads-1) {
+        c->num_edges = offset + n;
+        c->edge = malloc(MAX(1, c->num_edges) * sizeof *c->edge);
+    };
+    pthread_barrier_wait(&c->barrier);
+
+    for (long long v = lo; v < hi; v++) {
+        memcpy(c->edge + offset, sccg->edge[v], sccg->num_edges_[v] * sizeof *c->edge);
+        sccg->edge[v] = c->edge + offset;
+        offset += sccg->num_edges_[v];
+    };
+}
+
+
+/*
+ * Generate the SCC graph from g and the SCC scc[v] in [0,num_scc) of each
+ * vertex v, with at most one edge from one SCC to another, on num_threads
+ * threads, or parallel_threads() if that is <= 0.
+ */
+graph_t *graph_scc_condense_parallel(graph_t *g, int *scc, int num_scc, int num_threads) {
+    graph_condense_t c = { .g = g, .scc = scc };
+    int *old;
+
+    c.weight = calloc(num_scc, sizeof *c.weight);
+    num_threads = graph_build_threads(g->num_vertices, g->num_edges, num_threads);
+    c.block = malloc(num_threads * sizeof *c.block);
+    pthread_barrier_init(&c.barrier, NULL, num_threads);
+    parallel_run(num_threads, graph_condense_count, &c);
+
+    c.sccg = graph_build(num_scc, c.num_edges, c.source, c.target, 0, num_threads);
+    free(c.target);
+    free(c.source);
+    free(c.sccg->weight);
+    c.sccg->weight = c.weight;
+
+    old = c.sccg->edge[0];
+    parallel_run(num_threads, graph_condense_unique, &c);
+    c.sccg->edge[0] = c.edge;
+    c.sccg->num_edges = c.num_edges;
+    free(old);
+
+    pthread_barrier_destroy(&c.barrier);
+    free(c.block);
+
+    return c.sccg;
+}
+
+
+graph_t *graph_scc_condense(graph_t *g, int *scc, int num_scc) {
+    return graph_scc_condense_parallel(g, scc, num_scc, 1);
 }
 
 
@@ -160,70 +516,511 @@ void scc_find(graph_t *g, int v, int *np,
  * Reduce graph to its strongly connected components using Tarjan's algorithm.
  */
 graph_t *graph_scc_reduce(graph_t *g) {
-    int *scc = calloc(g->num_vertices, sizeof *scc), num_scc = 0;
+    int *scc = malloc(g->num_vertices * sizeof *scc), num_scc;
+
+    memset(scc, -1, g->num_vertices * sizeof *scc);
+    num_scc = graph_scc_label(g, scc, 0);
+
+    graph_t *sccg = graph_scc_condense(g, scc, num_scc);
+
+    free(scc);
+    return sccg;
+}
+
 
-    //
-    // Use Tarjan's algorithm to find strongly connected components (SCC)
-    //
-    int *index = calloc(g->num_vertices, sizeof *index);
-    int *low_link = calloc(g->num_vertices, sizeof *low_link);
-    int *on_stack = calloc(g->num_vertices, sizeof *on_stack);
+/*
+ * Graph with every edge of g reversed.
+ */
+graph_t *graph_transpose(graph_t *g) {
+    graph_t *gt = malloc(sizeof *gt);
+    int *I;
+
+    gt->num_vertices = g->num_vertices;
+    gt->num_edges = g->num_edges;
+    gt->weight = calloc(g->num_vertices, sizeof *gt->weight);
+    gt->num_edges_ = calloc(g->num_vertices, sizeof *gt->num_edges_);
+
+    for (int i = 0; i < g->num_vertices; i++)
+        for (int j = 0; j < g->num_edges_[i]; j++)
+            gt->num_edges_[g->edge[i][j]]++;
 
-    int n = 1;
-    int s[g->num_vertices], si = 0;
+    gt->edge = malloc(g->num_vertices * sizeof *gt->edge);
+    gt->edge[0] = malloc(g->num_edges * sizeof *gt->edge[0]);
+    for (int i = 1; i < g->num_vertices; i++)
+        gt->edge[i] = gt->edge[i-1] + gt->num_edges_[i-1];
 
+    I = calloc(g->num_vertices, sizeof *I);
     for (int i = 0; i < g->num_vertices; i++) {
-        if (index[i])
+        for (int j = 0; j < g->num_edges_[i]; j++) {
+            int tgt = g->edge[i][j];
+            gt->edge[tgt][I[tgt]++] = i;
+        };
+    };
+    free(I);
+
+    return gt;
+}
+
+
+/*
+ * Parallel SCC labelling by forward-backward search with trimming.
+ *
+ * First the vertices with no edges in or no edges out among the vertices
+ * left are trimmed off, each one an SCC of its own, which removes most of
+ * a sparse graph.  Every thread trims from its part of the vertices and
+ * goes on with the neighbours whose edge counts it brings down to zero,
+ * claiming each vertex with an atomic exchange on its SCC number.  Then
+ * the vertices reached from a pivot both forwards and backwards, by
+ * level-synchronous searches on the graph and its transpose, are the SCC
+ * of the pivot.  The pivot is the vertex with the most edges in times
+ * edges out, which is nearly always in the largest SCC if there is a giant
+ * one.  Trimming once more leaves the vertices whose SCCs are neither of
+ * these.
+ *
+ * Those are found by colouring, in rounds.  Every vertex left starts with
+ * its own number as its colour, and larger colours are pushed along the
+ * edges until nothing changes, so that the colour of a vertex is the
+ * largest vertex reaching it.  A vertex whose colour is its own number is
+ * a root, and the vertices of its colour which reach it are its SCC.  One
+ * backward search from all roots at once, which only crosses edges within
+ * a colour, labels them all, and every colour gives up at least its root's
+ * SCC.  Trimming follows each round.  Once fewer than SCC_COLOR_MIN
+ * vertices are left, or a round labels fewer than one in
+ * SCC_COLOR_PROGRESS of them, as for a long chain of SCCs whose colours
+ * all come from its head, Tarjan's algorithm numbers the rest on a single
+ * thread.
+ *
+ * Threads meet at a barrier after every level of a search and every step
+ * of colouring, except that runs of levels smaller than SCC_SERIAL_LEVEL
+ * vertices are searched by one thread alone.
+ */
+
+#define SCC_SERIAL_LEVEL    4096
+#define SCC_BUFFER          1024
+#define SCC_CLAIMED         (-2)
+#define SCC_COLOR_MIN       4096
+#define SCC_COLOR_PROGRESS  8
+
+enum { SCC_FORWARD, SCC_BACKWARD, SCC_COLOR };
+
+
+typedef struct scc_parallel {
+    graph_t *g, *gt;                // the graph and its transpose
+    int *scc, num_scc;              // [num_vertices] SCC of each vertex, or < 0
+    int *in, *out;                  // [num_vertices] edges from and to vertices left
+    unsigned char *fw, *bw;         // [num_vertices] reached forwards, backwards
+    int *color;                     // [num_vertices] largest vertex left reaching each
+    int *stamp;                     // [num_vertices] last colouring step to queue each
+    int *queue;                     // [2*num_vertices] vertices reached, by level
+    int count[3];                   // vertices added to queue[] by each step
+    int begin, end;                 // level, or step and its size, left serially
+    int *pivot;                     // [num_threads] best pivot of each thread
+    int *left;                      // [num_threads] vertices left in each range
+    pthread_barrier_t barrier;
+} scc_parallel_t;
+
+
+/*
+ * Claim vertex v for an SCC of its own.  Returns whether this thread got it.
+ */
+static int scc_claim(scc_parallel_t *w, int v) {
+    int left = -1;
+
+    if (!__atomic_compare_exchange_n(&w->scc[v], &left, SCC_CLAIMED, 0,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        return 0;
+
+    __atomic_store_n(&w->scc[v], __atomic_fetch_add(&w->num_scc, 1, __ATOMIC_RELAXED),
+        __ATOMIC_RELAXED);
+    return 1;
+}
+
+
+static void scc_trim(scc_parallel_t *w, int t, int num_threads) {
+    graph_t *g = w->g, *gt = w->gt;
+    int *scc = w->scc, size = 0, max_size = 64;
+    int *stack = malloc(max_size * sizeof *stack);
+    long long lo, hi;
+
+    parallel_range(g->num_vertices, t, num_threads, &lo, &hi);
+    for (long long v = lo; v < hi; v++) {
+        w->in[v] = w->out[v] = 0;
+        if (scc[v] >= 0)
+            continue;
+        for (int j = 0; j < gt->num_edges_[v]; j++)
+            w->in[v] += scc[gt->edge[v][j]] < 0;
+        for (int j = 0; j < g->num_edges_[v]; j++)
+            w->out[v] += scc[g->edge[v][j]] < 0;
+    };
+    pthread_barrier_wait(&w->barrier);
+
+    for (long long v = lo; v < hi; v++) {
+        if (__atomic_load_n(&scc[v], __ATOMIC_RELAXED) != -1
+                || (__atomic_load_n(&w->in[v], __ATOMIC_RELAXED) > 0
+                    && __atomic_load_n(&w->out[v], __ATOMIC_RELAXED) > 0)
+                || !scc_claim(w, v))
             continue;
 
-        scc_find(g, i, &n, index, low_link, on_stack, s, &si, scc, &num_scc);
+        stack[size++] = v;
+        while (size > 0) {
+            int u = stack[--size];
+
+            for (int k = 0; k < 2; k++) {
+                graph_t *e = k ? gt : g;
+                int *count = k ? w->out : w->in;
+
+                for (int j = 0; j < e->num_edges_[u]; j++) {
+                    int x = e->edge[u][j];
+
+                    if (__atomic_load_n(&scc[x], __ATOMIC_RELAXED) != -1
+                            || __atomic_sub_fetch(&count[x], 1, __ATOMIC_RELAXED) != 0
+                            || !scc_claim(w, x))
+                        continue;
+                    if (size == max_size)
+                        stack = realloc(stack, (max_size *= 2) * sizeof *stack);
+                    stack[size++] = x;
+                };
+            };
+        };
     };
+    free(stack);
+    pthread_barrier_wait(&w->barrier);
+}
 
-    free(index);
-    free(low_link);
-    free(on_stack);
 
+static void scc_flush(scc_parallel_t *w, int step, int base, int *buf, int *n) {
+    int at = base + __atomic_fetch_add(&w->count[step % 3], *n, __ATOMIC_RELAXED);
 
-    //
-    // Generate the SCC graph from g and the results of Tarjan's algorithm
-    //
-    graph_t *sccg = malloc(sizeof *sccg);
+    memcpy(w->queue + at, buf, *n * sizeof *buf);
+    *n = 0;
+}
 
-    sccg->num_vertices = num_scc;
-    sccg->num_edges = 0;
 
-    sccg->weight = calloc(num_scc, sizeof *sccg->weight);
-    sccg->num_edges_ = calloc(num_scc, sizeof *sccg->num_edges_);
+/*
+ * Whether a search in the given mode takes vertex x, reached over an edge
+ * from v, and claims it for itself.  The forward and backward searches
+ * from the pivot mark the vertices left which they reach, and the colour
+ * search puts x into the SCC of v if it has the same colour.
+ */
+static int scc_join(scc_parallel_t *w, int mode, int v, int x) {
+    unsigned char *mark = mode == SCC_FORWARD ? w->fw : w->bw;
+    int left = -1;
 
-    // go through the original graph's edges and count those that remain valid
-    for (int i = 0; i < g->num_vertices; i++) {
-        for (int j = 0; j < g->num_edges_[i]; j++) {
-            int src = scc[i], tgt = scc[g->edge[i][j]];
-            if (src != tgt) {
-                sccg->num_edges++;
-                sccg->num_edges_[src]++;
+    if (__atomic_load_n(&w->scc[x], __ATOMIC_RELAXED) >= 0)
+        return 0;
+    if (mode == SCC_COLOR)
+        return w->color[x] == w->color[v] && __atomic_compare_exchange_n(&w->scc[x], &left,
+            w->scc[v], 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+    return !__atomic_load_n(&mark[x], __ATOMIC_RELAXED)
+        && !__atomic_exchange_n(&mark[x], 1, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Search e level by level from the count[0] vertices in queue[], taking
+ * the vertices scc_join() lets in.  Step s counts the vertices it adds in
+ * count[s % 3], which thread 0 clears two steps ahead, once every thread
+ * is past reading it.
+ */
+static void scc_reach(scc_parallel_t *w, int t, int num_threads, graph_t *e, int mode) {
+    int *queue = w->queue;
+    int buf[SCC_BUFFER], n = 0, begin = 0, end = w->count[0], step = 1;
+    long long a, b;
+
+    for (; begin < end; step++) {
+        if (t == 0)
+            w->count[(step+1) % 3] = 0;
+
+        if (end - begin < SCC_SERIAL_LEVEL) {
+            if (t == 0) {
+                int tail = end;
+
+                while (begin < end && end - begin < SCC_SERIAL_LEVEL) {
+                    for (int k = begin; k < end; k++) {
+                        int v = queue[k];
+
+                        for (int j = 0; j < e->num_edges_[v]; j++)
+                            if (scc_join(w, mode, v, e->edge[v][j]))
+                                queue[tail++] = e->edge[v][j];
+                    };
+                    begin = end, end = tail;
+                };
+                w->begin = begin, w->end = end;
             };
+            pthread_barrier_wait(&w->barrier);
+            begin = w->begin, end = w->end;
+            pthread_barrier_wait(&w->barrier);
+        } else {
+            parallel_range(end - begin, t, num_threads, &a, &b);
+            for (long long k = begin+a; k < begin+b; k++) {
+                int v = queue[k];
+
+                for (int j = 0; j < e->num_edges_[v]; j++) {
+                    int x = e->edge[v][j];
+
+                    if (!scc_join(w, mode, v, x))
+                        continue;
+                    buf[n++] = x;
+                    if (n == SCC_BUFFER)
+                        scc_flush(w, step, end, buf, &n);
+                };
+            };
+            scc_flush(w, step, end, buf, &n);
+            pthread_barrier_wait(&w->barrier);
+            begin = end, end += w->count[step % 3];
         };
     };
+}
 
-    // reserve space for edges
-    sccg->edge = malloc(num_scc * sizeof *sccg->edge);
-    sccg->edge[0] = malloc(sccg->num_edges * sizeof *sccg->edge[0]);
-    for (int i = 1; i < num_scc; i++)
-        sccg->edge[i] = sccg->edge[i-1] + sccg->num_edges_[i-1];
 
-    // fill in edges & update weights
-    int *I = calloc(num_scc, sizeof *I);
-    for (int i = 0; i < g->num_vertices; i++) {
-        sccg->weight[scc[i]]++;
-        for (int j = 0; j < g->num_edges_[i]; j++) {
-            int src = scc[i], tgt = scc[g->edge[i][j]];
-            if (src != tgt) {
-                sccg->edge[src][I[src]++] = tgt;
+/*
+ * Search e from the pivot alone.
+ */
+static void scc_reach_pivot(scc_parallel_t *w, int t, int num_threads, graph_t *e, int mode,
+        int pivot)
+{
+    pthread_barrier_wait(&w->barrier);
+    if (t == 0) {
+        (mode == SCC_FORWARD ? w->fw : w->bw)[pivot] = 1;
+        w->queue[0] = pivot;
+        w->count[0] = 1, w->count[1] = w->count[2] = 0;
+    };
+    pthread_barrier_wait(&w->barrier);
+
+    scc_reach(w, t, num_threads, e, mode);
+}
+
+
+/*
+ * Raise the colour of x to c, if x is left and its colour is smaller, and
+ * whether x joins the vertices changed by this step.  stamp[x] holds the
+ * last step which added it, so that it is added at most once per step.
+ */
+static int scc_raise(scc_parallel_t *w, int c, int x, int step) {
+    int old;
+
+    if (w->scc[x] >= 0)
+        return 0;
+    old = __atomic_load_n(&w->color[x], __ATOMIC_RELAXED);
+    while (old < c && !__atomic_compare_exchange_n(&w->color[x], &old, c, 0,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+
+    return old < c && __atomic_exchange_n(&w->stamp[x], step, __ATOMIC_RELAXED) != step;
+}
+
+
+/*
+ * Push larger colours along the edges until none changes, first out of the
+ * vertices rest[0..num_rest) and then out of those changed by the step
+ * before.  Step s queues these in the half (s % 2) of queue[], counted in
+ * count[s % 3] as in a search, and runs of steps changing fewer than
+ * SCC_SERIAL_LEVEL vertices are taken by thread 0 alone.
+ */
+static void scc_spread(scc_parallel_t *w, int t, int num_threads, int *rest, int num_rest) {
+    graph_t *g = w->g;
+    int N = g->num_vertices, *color = w->color;
+    int buf[SCC_BUFFER], n = 0, step = 1, size;
+    long long a, b;
+
+    for (int k = 0; k < num_rest; k++) {
+        int v = rest[k];
+
+        for (int j = 0; j < g->num_edges_[v]; j++) {
+            if (!scc_raise(w, __atomic_load_n(&color[v], __ATOMIC_RELAXED), g->edge[v][j], step))
+                continue;
+            buf[n++] = g->edge[v][j];
+            if (n == SCC_BUFFER)
+                scc_flush(w, step, N, buf, &n);
+        };
+    };
+    scc_flush(w, step, N, buf, &n);
+    pthread_barrier_wait(&w->barrier);
+    size = w->count[step % 3];
+
+    while (size > 0) {
+        int *queue = w->queue + step % 2 * N;
+
+        step++;
+        if (size < SCC_SERIAL_LEVEL) {
+            if (t == 0) {
+                while (size > 0 && size < SCC_SERIAL_LEVEL) {
+                    int *next = w->queue + step % 2 * N, tail = 0;
+
+                    for (int k = 0; k < size; k++) {
+                        int v = queue[k];
+
+                        for (int j = 0; j < g->num_edges_[v]; j++)
+                            if (scc_raise(w, color[v], g->edge[v][j], step))
+                                next[tail++] = g->edge[v][j];
+                    };
+                    queue = next, size = tail, step++;
+                };
+                w->begin = --step, w->end = size;
+            };
+            pthread_barrier_wait(&w->barrier);
+            step = w->begin, size = w->end;
+            if (t == 0)
+                w->count[0] = w->count[1] = w->count[2] = 0;
+            pthread_barrier_wait(&w->barrier);
+        } else {
+            if (t == 0)
+                w->count[(step+1) % 3] = 0;
+            parallel_range(size, t, num_threads, &a, &b);
+            for (long long k = a; k < b; k++) {
+                int v = queue[k], c = __atomic_load_n(&color[v], __ATOMIC_RELAXED);
+
+                for (int j = 0; j < g->num_edges_[v]; j++) {
+                    if (!scc_raise(w, c, g->edge[v][j], step))
+                        continue;
+                    buf[n++] = g->edge[v][j];
+                    if (n == SCC_BUFFER)
+                        scc_flush(w, step, step % 2 * N, buf, &n);
+                };
             };
+            scc_flush(w, step, step % 2 * N, buf, &n);
+            pthread_barrier_wait(&w->barrier);
+            size = w->count[step % 3];
         };
     };
-    free(I);
+}
+
+
+static void scc_parallel_worker(void *arg, int t, int num_threads) {
+    scc_parallel_t *w = arg;
+    int N = w->g->num_vertices, pivot = -1, label;
+    int buf[SCC_BUFFER], n = 0, *rest, num_rest;
+    long long lo, hi, best = -1, total, last = -1;
+
+    scc_trim(w, t, num_threads);
+
+    // the pivot for the forward-backward search
+    parallel_range(N, t, num_threads, &lo, &hi);
+    for (long long v = lo; v < hi; v++) {
+        if (w->scc[v] < 0 && (long long)w->in[v] * w->out[v] > best)
+            best = (long long)w->in[v] * w->out[v], pivot = v;
+    };
+    w->pivot[t] = pivot;
+    pthread_barrier_wait(&w->barrier);
+
+    pivot = best = -1;
+    for (int u = 0; u < num_threads; u++) {
+        int p = w->pivot[u];
+
+        if (p >= 0 && (pivot < 0 || (long long)w->in[p] * w->out[p] > best))
+            best = (long long)w->in[p] * w->out[p], pivot = p;
+    };
+    if (pivot < 0)
+        return;
+
+    scc_reach_pivot(w, t, num_threads, w->g, SCC_FORWARD, pivot);
+    scc_reach_pivot(w, t, num_threads, w->gt, SCC_BACKWARD, pivot);
+
+    label = w->num_scc;
+    for (long long v = lo; v < hi; v++)
+        if (w->scc[v] < 0 && w->fw[v] && w->bw[v])
+            w->scc[v] = label;
+    pthread_barrier_wait(&w->barrier);
+    if (t == 0)
+        w->num_scc++;
+
+    scc_trim(w, t, num_threads);
+
+    // colouring rounds, for as long as they pay
+    rest = malloc((hi - lo) * sizeof *rest);
+    for (;;) {
+        num_rest = 0;
+        for (long long v = lo; v < hi; v++)
+            if (w->scc[v] < 0)
+                rest[num_rest++] = v, w->color[v] = v, w->stamp[v] = 0;
+        w->left[t] = num_rest;
+        if (t == 0)
+            w->count[0] = w->count[1] = w->count[2] = 0;
+        pthread_barrier_wait(&w->barrier);
+
+        total = 0;
+        for (int u = 0; u < num_threads; u++)
+            total += w->left[u];
+        if (total < SCC_COLOR_MIN || (last >= 0 && last - total < last / SCC_COLOR_PROGRESS))
+            break;
+        last = total;
+
+        scc_spread(w, t, num_threads, rest, num_rest);
+        pthread_barrier_wait(&w->barrier);
+        if (t == 0)
+            w->count[0] = w->count[1] = w->count[2] = 0;
+        pthread_barrier_wait(&w->barrier);
+
+        // the roots, from which their SCCs grow backwards within their colour
+        for (int k = 0; k < num_rest; k++) {
+            if (w->color[rest[k]] != rest[k] || !scc_claim(w, rest[k]))
+                continue;
+            buf[n++] = rest[k];
+            if (n == SCC_BUFFER)
+                scc_flush(w, 0, 0, buf, &n);
+        };
+        scc_flush(w, 0, 0, buf, &n);
+        pthread_barrier_wait(&w->barrier);
+        scc_reach(w, t, num_threads, w->gt, SCC_COLOR);
+
+        scc_trim(w, t, num_threads);
+    };
+    free(rest);
+}
+
+
+/*
+ * Same as graph_scc_label() for a graph with no SCCs found yet, on
+ * num_threads threads, or parallel_threads() if that is <= 0.
+ */
+int graph_scc_label_parallel(graph_t *g, int *scc, int num_threads) {
+    int N = g->num_vertices;
+    scc_parallel_t w = {
+        .g = g, .gt = graph_transpose(g),
+        .scc = scc,
+        .in = malloc(N * sizeof *w.in),
+        .out = malloc(N * sizeof *w.out),
+        .fw = calloc(N, 1),
+        .bw = calloc(N, 1),
+        .color = malloc(N * sizeof *w.color),
+        .stamp = malloc(N * sizeof *w.stamp),
+        .queue = malloc(2 * N * sizeof *w.queue),
+    };
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    num_threads = MAX(1, MIN(num_threads, N / SCC_BUFFER));
+
+    w.pivot = malloc(num_threads * sizeof *w.pivot);
+    w.left = malloc(num_threads * sizeof *w.left);
+    memset(scc, -1, N * sizeof *scc);
+    pthread_barrier_init(&w.barrier, NULL, num_threads);
+    parallel_run(num_threads, scc_parallel_worker, &w);
+    pthread_barrier_destroy(&w.barrier);
+
+    free(w.left);
+    free(w.pivot);
+    free(w.queue);
+    free(w.stamp);
+    free(w.color);
+    free(w.bw);
+    free(w.fw);
+    free(w.out);
+    free(w.in);
+    graph_delete(w.gt);
+
+    return graph_scc_label(g, scc, w.num_scc);
+}
+
+
+/*
+ * Same as graph_scc_reduce() with the SCCs found on num_threads threads.
+ */
+graph_t *graph_scc_reduce_parallel(graph_t *g, int num_threads) {
+    int *scc = malloc(g->num_vertices * sizeof *scc);
+    int num_scc = graph_scc_label_parallel(g, scc, num_threads);
+    graph_t *sccg = graph_scc_condense_parallel(g, scc, num_scc, num_threads);
 
     free(scc);
     return sccg;
@@ -238,8 +1035,8 @@ int graph_longest_path(graph_t *g) {
     int *w = calloc(g->num_vertices, sizeof *w);
 
     int r;
-    int i[g->num_vertices];
-    int j[g->num_vertices];
+    int *i = malloc(g->num_vertices * sizeof *i);
+    int *j = malloc(g->num_vertices * sizeof *j);
 
     for (int i0 = 0; i0 < g->num_vertices; i0++) {
         if (w[i0])
@@ -265,11 +1062,209 @@ int graph_longest_path(graph_t *g) {
         W = MAX(W, w[i0]);
     };
 
+    free(j);
+    free(i);
     free(w);
     return W;
 }
 
 
+/*
+ * Longest path in a directed acyclic graph by levels.
+ *
+ * Level 0 holds the vertices with no edges out, and level l+1 those whose
+ * edges all lead into levels up to l.  The levels are peeled off as in
+ * Kahn's algorithm, counting down the edges left out of each vertex over
+ * the transposed graph, with the vertices of each new level appended to
+ * queue[] by all threads at once.  Then the longest path from a vertex
+ * only depends on the levels before its own, so every level is one pass
+ * over its vertices reading their successors, split between the threads
+ * without any atomics.  As in scc_reach(), runs of levels smaller than
+ * PATH_SERIAL_LEVEL vertices are handled by one thread alone.
+ */
+
+#define PATH_SERIAL_LEVEL   4096
+#define PATH_BUFFER         1024
+
+
+typedef struct path_parallel {
+    graph_t *g, *gt;
+    int *left;                      // [num_vertices] edges out to vertices in no level yet
+    int *queue;                     // [num_vertices] vertices by level
+    int *level, num_levels;         // [num_vertices+1] start of each level in queue[]
+    int *w;                         // [num_vertices] longest path from each vertex
+    int *best;                      // [num_threads] longest path seen by each thread
+    int count[3];                   // vertices added to queue[] by each step
+    int begin, end;                 // level left by the last serial step
+    pthread_barrier_t barrier;
+} path_parallel_t;
+
+
+static void path_flush(path_parallel_t *p, int step, int base, int *buf, int *n) {
+    int at = base + __atomic_fetch_add(&p->count[step % 3], *n, __ATOMIC_RELAXED);
+
+    memcpy(p->queue + at, buf, *n * sizeof *buf);
+    *n = 0;
+}
+
+
+/*
+ * Fill queue[] with the vertices by level.  Step s counts the vertices it
+ * adds in count[s % 3], which thread 0 clears two steps ahead, once every
+ * thread is past reading it.
+ */
+static void path_levels(path_parallel_t *p, int t, int num_threads) {
+    graph_t *g = p->g, *gt = p->gt;
+    int *left = p->left, *queue = p->queue;
+    int buf[PATH_BUFFER], n = 0, begin = 0, end, step = 1;
+    long long a, b;
+
+    // level 0
+    parallel_range(g->num_vertices, t, num_threads, &a, &b);
+    for (long long v = a; v < b; v++) {
+        left[v] = g->num_edges_[v];
+        if (left[v] > 0)
+            continue;
+        buf[n++] = v;
+        if (n == PATH_BUFFER)
+            path_flush(p, 0, 0, buf, &n);
+    };
+    path_flush(p, 0, 0, buf, &n);
+    pthread_barrier_wait(&p->barrier);
+    end = p->count[0];
+    if (t == 0)
+        p->level[0] = 0, p->level[1] = end, p->num_levels = 1;
+
+    for (; begin < end; step++) {
+        if (t == 0)
+            p->count[(step+1) % 3] = 0;
+
+        if (end - begin < PATH_SERIAL_LEVEL) {
+            if (t == 0) {
+                int tail = end;
+
+                while (begin < end && end - begin < PATH_SERIAL_LEVEL) {
+                    for (int k = begin; k < end; k++) {
+                        int v = queue[k];
+
+                        for (int j = 0; j < gt->num_edges_[v]; j++) {
+                            int u = gt->edge[v][j];
+                            if (--left[u] == 0)
+                                queue[tail++] = u;
+                        };
+                    };
+                    if (tail > end)
+                        p->level[++p->num_levels] = tail;
+                    begin = end, end = tail;
+                };
+                p->begin = begin, p->end = end;
+            };
+            pthread_barrier_wait(&p->barrier);
+            begin = p->begin, end = p->end;
+            pthread_barrier_wait(&p->barrier);
+        } else {
+            parallel_range(end - begin, t, num_threads, &a, &b);
+            for (long long k = begin+a; k < begin+b; k++) {
+                int v = queue[k];
+
+                for (int j = 0; j < gt->num_edges_[v]; j++) {
+                    int u = gt->edge[v][j];
+
+                    if (__atomic_sub_fetch(&left[u], 1, __ATOMIC_RELAXED) != 0)
+                        continue;
+                    buf[n++] = u;
+                    if (n == PATH_BUFFER)
+                        path_flush(p, step, end, buf, &n);
+                };
+            };
+            path_flush(p, step, end, buf, &n);
+            pthread_barrier_wait(&p->barrier);
+            begin = end, end += p->count[step % 3];
+            if (t == 0 && end > begin)
+                p->level[++p->num_levels] = end;
+        };
+    };
+}
+
+
+static int path_update(path_parallel_t *p, int v) {
+    graph_t *g = p->g;
+    int m = 0;
+
+    for (int j = 0; j < g->num_edges_[v]; j++)
+        m = MAX(m, p->w[g->edge[v][j]]);
+
+    return p->w[v] = g->weight[v] + m;
+}
+
+
+static void path_parallel_worker(void *arg, int t, int num_threads) {
+    path_parallel_t *p = arg;
+    int *level = p->level, best = 0;
+    long long a, b;
+
+    path_levels(p, t, num_threads);
+    pthread_barrier_wait(&p->barrier);
+
+    for (int l = 0; l < p->num_levels; ) {
+        if (level[l+1] - level[l] < PATH_SERIAL_LEVEL) {
+            int k = l;
+
+            while (k < p->num_levels && level[k+1] - level[k] < PATH_SERIAL_LEVEL)
+                k++;
+            if (t == 0)
+                for (int i = level[l]; i < level[k]; i++)
+                    best = MAX(best, path_update(p, p->queue[i]));
+            l = k;
+        } else {
+            parallel_range(level[l+1] - level[l], t, num_threads, &a, &b);
+            for (long long i = level[l]+a; i < level[l]+b; i++)
+                best = MAX(best, path_update(p, p->queue[i]));
+            l++;
+        };
+        pthread_barrier_wait(&p->barrier);
+    };
+    p->best[t] = best;
+}
+
+
+/*
+ * Same as graph_longest_path() on num_threads threads, or
+ * parallel_threads() if that is <= 0.
+ */
+int graph_longest_path_parallel(graph_t *g, int num_threads) {
+    int N = g->num_vertices, W = 0;
+    path_parallel_t p = {
+        .g = g, .gt = graph_transpose(g),
+        .left = malloc(N * sizeof *p.left),
+        .queue = malloc(N * sizeof *p.queue),
+        .level = malloc((N+1) * sizeof *p.level),
+        .w = malloc(N * sizeof *p.w),
+    };
+
+    if (num_threads <= 0)
+        num_threads = parallel_threads();
+    num_threads = MAX(1, MIN(num_threads, N / PATH_BUFFER));
+
+    p.best = malloc(num_threads * sizeof *p.best);
+    pthread_barrier_init(&p.barrier, NULL, num_threads);
+    parallel_run(num_threads, path_parallel_worker, &p);
+    pthread_barrier_destroy(&p.barrier);
+
+    for (int t = 0; t < num_threads; t++)
+        W = MAX(W, p.best[t]);
+
+    free(p.best);
+    free(p.w);
+    free(p.level);
+    free(p.queue);
+    free(p.left);
+    graph_delete(p.gt);
+
+    return W;
+}
+
+
 int getMaxVisitableWebpages(int N, int M, int *A, int *B) {
     graph_t *g = graph_new(N, M, A, B);
     // graph_print(g);
@@ -277,10 +1272,33 @@ int getMaxVisitableWebpages(int N, int M, int *A, int *B) {
     graph_t *sccg = graph_scc_reduce(g);
     // graph_print(sccg);
 
-    return graph_longest_path(sccg);
+    int result = graph_longest_path(sccg);
+
+    graph_delete(sccg);
+    graph_delete(g);
+
+    return result;
 }
 
 
+/*
+ * Same as getMaxVisitableWebpages() on num_threads threads, or
+ * parallel_threads() if that is <= 0.
+ */
+int getMaxVisitableWebpagesParallel(int N, int M, int *A, int *B, int num_threads) {
+    graph_t *g = graph_new_parallel(N, M, A, B, num_threads);
+    graph_t *sccg = graph_scc_reduce_parallel(g, num_threads);
+    int result = graph_longest_path_parallel(sccg, num_threads);
+
+    graph_delete(sccg);
+    graph_delete(g);
+
+    return result;
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getMaxVisitableWebpages(4, 4, (int []){1,2,3,4}, (int []){4,1,2,1}), 4);
@@ -290,5 +1308,307 @@ int main(int argc, char **argv) {
         getMaxVisitableWebpages(10, 9, (int []){3,2,5,9,10,3,3,9,4}, (int []){9,5,7,8,6,4,5,3,9}), 5);
     printf("result = %d, expected = %d\n",
         getMaxVisitableWebpages(5, 6, (int []){1,2,3,3,4,5}, (int []){2,3,1,4,5,2}), 5);
+
+    // random small graphs against the components found from reachability,
+    // and the longest path through them by trying every vertex order
+    int A[12], B[12], errors = 0;
+    srand(1);
+    for (int t = 0; t < 2000; t++) {
+        int N = rand() % 7 + 2, M = rand() % 12 + 1, best = 0;
+        int reach[8][8] = { 0 }, perm[8];
+
+        for (int k = 0; k < M; k++) {
+            A[k] = rand() % N + 1;
+            do B[k] = rand() % N + 1; while (B[k] == A[k]);
+            reach[A[k]-1][B[k]-1] = 1;
+        };
+        for (int i = 0; i < N; i++)
+            reach[i][i] = 1;
+        for (int k = 0; k < N; k++)
+            for (int i = 0; i < N; i++)
+                for (int j = 0; j < N; j++)
+                    reach[i][j] |= reach[i][k] && reach[k][j];
+
+        // a session visits whole components in an order where each reaches the next
+        for (int mask = 1; mask < 1 << N; mask++) {
+            int n = 0, ok = 1;
+
+            for (int i = 0; i < N; i++)
+                if (mask & 1 << i)
+                    perm[n++] = i;
+            for (int i = 0; i < n && ok; i++)
+                for (int j = 0; j < N; j++)
+                    if (reach[perm[i]][j] && reach[j][perm[i]] && !(mask & 1 << j))
+                        ok = 0;
+            for (int i = 0; i < n && ok; i++)
+                for (int j = i+1; j < n; j++)
+                    if (!reach[perm[i]][perm[j]] && !reach[perm[j]][perm[i]])
+                        ok = 0;
+            if (ok)
+                best = MAX(best, n);
+        };
+
+        errors += getMaxVisitableWebpages(N, M, A, B) != best;
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+
+    // a chain and a loop of a million pages, far deeper than the C stack
+    int N = 1000000, *C = malloc(N * sizeof *C), *D = malloc(N * sizeof *D);
+    for (int i = 0; i < N; i++)
+        C[i] = i+1, D[i] = i+2;
+    printf("result = %d, expected = %d\n", getMaxVisitableWebpages(N, N-1, C, D), N);
+    printf("result = %d, expected = %d\n", getMaxVisitableWebpagesParallel(N, N-1, C, D, 4), N);
+    D[N-1] = 1;
+    printf("result = %d, expected = %d\n", getMaxVisitableWebpages(N, N, C, D), N);
+    printf("result = %d, expected = %d\n", getMaxVisitableWebpagesParallel(N, N, C, D, 4), N);
+
+    // the parallel labelling against Tarjan's, as partitions of the vertices,
+    // on graphs from far below to well above one edge per vertex, then on
+    // cycles of 50 to 300 pages in random order linked into a DAG, which
+    // leave many SCCs to colour after the pivot's
+    int *scc = malloc(N * sizeof *scc), *ref = malloc(N * sizeof *ref);
+    int *map = malloc(N * sizeof *map), *inv = malloc(N * sizeof *inv);
+    errors = 0;
+    for (int t = 0; t < 36; t++) {
+        int n = rand() % 200000 + 2, m = (long long)n * (t % 6 + 1) / 3, k;
+        graph_t *g;
+
+        if (t < 24) {
+            for (int i = 0; i < m; i++) {
+                C[i] = rand() % n + 1;
+                do D[i] = rand() % n + 1; while (D[i] == C[i]);
+            };
+        } else {
+            for (int v = 0; v < n; v++) {
+                int u = rand() % (v+1);
+
+                map[v] = map[u], map[u] = v+1;
+            };
+            m = 0;
+            for (int v = 0, len; v < n; v += len) {
+                len = rand() % 251 + 50;
+                len = MIN(len, n - v);
+                for (int i = 0; i < len && len > 1; i++)
+                    C[m] = map[v+i], D[m++] = map[v + (i+1) % len];
+            };
+            for (int i = 0; i < n / (t % 3 + 1) && n > 2; i++) {
+                int a = rand() % (n-1);
+
+                C[m] = map[a], D[m++] = map[a + 1 + rand() % (n-a-1)];
+            };
+        };
+        g = graph_new(n, m, C, D);
+        k = graph_scc_label_parallel(g, scc, t % 8 + 1);
+        memset(ref, -1, n * sizeof *ref);
+        errors += graph_scc_label(g, ref, 0) != k;
+
+        memset(map, -1, n * sizeof *map);
+        memset(inv, -1, n * sizeof *inv);
+        for (int v = 0; v < n; v++) {
+            if (scc[v] < 0 || scc[v] >= k) {
+                errors++;
+                continue;
+            };
+            if (map[scc[v]] < 0 && inv[ref[v]] < 0)
+                map[scc[v]] = ref[v], inv[ref[v]] = scc[v];
+            errors += map[scc[v]] != ref[v];
+        };
+
+        errors += getMaxVisitableWebpagesParallel(n, m, C, D, t % 8 + 1)
+            != getMaxVisitableWebpages(n, m, C, D);
+
+        // the same lists in the same order from any number of threads, and
+        // SCC lists in increasing order without repeats
+        graph_t *h = graph_new_parallel(n, m, C, D, t % 8 + 1);
+        errors += memcmp(h->num_edges_, g->num_edges_, n * sizeof *h->num_edges_) != 0
+            || memcmp(h->edge[0], g->edge[0], m * sizeof *h->edge[0]) != 0;
+        graph_delete(h);
+
+        h = graph_scc_condense_parallel(g, scc, k, t % 8 + 1);
+        for (int v = 0, w = 0; v < k; v++) {
+            w += h->weight[v];
+            for (int j = 1; j < h->num_edges_[v]; j++)
+                errors += h->edge[v][j] <= h->edge[v][j-1];
+            errors += v == k-1 && w != n;
+        };
+        graph_delete(h);
+        graph_delete(g);
+    };
+    printf("result = %d, expected = %d\n", errors, 0);
+    free(inv);
+    free(map);
+    free(ref);
+    free(scc);
+    free(D);
+    free(C);
+}
+
+#else
+
+/*
+ * Build the graph of the links on num_threads threads, 0 for the serial
+ * graph_new().
+ */
+long long buildGraph(int N, int M, int *A, int *B, int num_threads) {
+    graph_t *g = num_threads ? graph_new_parallel(N, M, A, B, num_threads)
+        : graph_new(N, M, A, B);
+    long long result = g->edge[0][M-1];
+
+    graph_delete(g);
+    return result;
+}
+
+
+long long condenseGraph(graph_t *g, int *scc, int num_scc, int num_threads) {
+    graph_t *sccg = graph_scc_condense_parallel(g, scc, num_scc, num_threads);
+    long long result = sccg->num_edges;
+
+    graph_delete(sccg);
+    return result;
+}
+
+
+long long labelGraph(graph_t *g, int *scc, int num_threads) {
+    if (num_threads)
+        return graph_scc_label_parallel(g, scc, num_threads);
+
+    memset(scc, -1, g->num_vertices * sizeof *scc);
+    return graph_scc_label(g, scc, 0);
+}
+
+
+/*
+ * The build and condensation of M random links between N pages, serial
+ * and on 1 to 32 threads.
+ */
+void benchBuild(const char *size, int N, int M, int *A, int *B) {
+    int *scc = malloc(N * sizeof *scc), num_scc;
+    graph_t *g;
+    char name[64];
+
+    for (int i = 0; i < M; i++) {
+        A[i] = bench_range(1, N);
+        do B[i] = bench_range(1, N); while (B[i] == A[i]);
+    };
+
+    snprintf(name, sizeof name, "%s-build", size);
+    BENCH_CASE(name, M, 3, , buildGraph(N, M, A, B, 0));
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        snprintf(name, sizeof name, "%s-build-parallel-%d", size, threads);
+        BENCH_CASE(name, M, 3, , buildGraph(N, M, A, B, threads));
+    };
+
+    g = graph_new(N, M, A, B);
+    memset(scc, -1, N * sizeof *scc);
+    num_scc = graph_scc_label(g, scc, 0);
+    snprintf(name, sizeof name, "%s-condense", size);
+    BENCH_CASE(name, M, 3, , condenseGraph(g, scc, num_scc, 1));
+    for (int threads = 2; threads <= 32; threads *= 2) {
+        snprintf(name, sizeof name, "%s-condense-parallel-%d", size, threads);
+        BENCH_CASE(name, M, 3, , condenseGraph(g, scc, num_scc, threads));
+    };
+
+    graph_delete(g);
+    free(scc);
+}
+
+
+int main(int argc, char **argv) {
+    int N = 500000, M = 500000;
+    int *A = malloc(M * sizeof *A), *B = malloc(M * sizeof *B);
+
+    bench_seed(1);
+    for (int i = 0; i < M; i++) {
+        A[i] = bench_range(1, N);
+        do B[i] = bench_range(1, N); while (B[i] == A[i]);
+    };
+    BENCH_CASE("random", M, 3, , getMaxVisitableWebpages(N, M, A, B));
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        char name[64];
+
+        snprintf(name, sizeof name, "random-parallel-%d", threads);
+        BENCH_CASE(name, M, 3, , getMaxVisitableWebpagesParallel(N, M, A, B, threads));
+    };
+
+    // a single chain through every page, as deep as a search can go
+    for (int i = 0; i < N-1; i++)
+        A[i] = i+1, B[i] = i+2;
+    BENCH_CASE("chain", N, 3, , getMaxVisitableWebpages(N, N-1, A, B));
+    BENCH_CASE("chain-parallel", N, 3, , getMaxVisitableWebpagesParallel(N, N-1, A, B, 0));
+
+    // links only to higher pages, so every page is an SCC of its own and
+    // the longest path search sees the whole graph
+    for (int i = 0; i < M; i++) {
+        A[i] = bench_range(1, N-1);
+        B[i] = bench_range(A[i]+1, MIN(N, A[i]+1000));
+    };
+    BENCH_CASE("dag", M, 3, , getMaxVisitableWebpages(N, M, A, B));
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        char name[64];
+
+        snprintf(name, sizeof name, "dag-parallel-%d", threads);
+        BENCH_CASE(name, M, 3, , getMaxVisitableWebpagesParallel(N, M, A, B, threads));
+    };
+
+    // cycles of 50 to 300 pages in random order linked into a DAG, one SCC
+    // after another for the labelling to find
+    int *scc = malloc(N * sizeof *scc), *map = malloc(N * sizeof *map);
+    for (int v = 0; v < N; v++) {
+        int u = bench_range(0, v);
+
+        map[v] = map[u], map[u] = v+1;
+    };
+    A = realloc(A, (N + N/2) * sizeof *A);
+    B = realloc(B, (N + N/2) * sizeof *B);
+    M = 0;
+    for (int v = 0, len; v < N; v += len) {
+        len = bench_range(50, 300);
+        len = MIN(len, N - v);
+        for (int i = 0; i < len && len > 1; i++)
+            A[M] = map[v+i], B[M++] = map[v + (i+1) % len];
+    };
+    for (int i = 0; i < N/2; i++) {
+        int a = bench_range(0, N-2);
+
+        A[M] = map[a], B[M++] = map[bench_range(a+1, N-1)];
+    };
+    graph_t *g = graph_new(N, M, A, B);
+    BENCH_CASE("cycles-label", M, 3, , labelGraph(g, scc, 0));
+    for (int threads = 1; threads <= 32; threads *= 2) {
+        char name[64];
+
+        snprintf(name, sizeof name, "cycles-label-parallel-%d", threads);
+        BENCH_CASE(name, M, 3, , labelGraph(g, scc, threads));
+    };
+    graph_delete(g);
+    free(map);
+    free(scc);
+
+    // ten links per page
+    M = 5000000;
+    A = realloc(A, M * sizeof *A);
+    B = realloc(B, M * sizeof *B);
+    benchBuild("random-5m", N, M, A, B);
+
+    if (argc > 1 && strcmp(argv[1], "large") == 0) {
+        N = M = 50000000;
+        A = realloc(A, M * sizeof *A);
+        B = realloc(B, M * sizeof *B);
+        for (int i = 0; i < N-1; i++)
+            A[i] = i+1, B[i] = i+2;
+        BENCH_CASE("chain-large", N, 1, , getMaxVisitableWebpages(N, N-1, A, B));
+        BENCH_CASE("chain-large-parallel", N, 1, ,
+            getMaxVisitableWebpagesParallel(N, N-1, A, B, 0));
+
+        // ten links per page on 10M pages, most of them in one SCC
+        N = 10000000, M = 100000000;
+        A = realloc(A, M * sizeof *A);
+        B = realloc(B, M * sizeof *B);
+        benchBuild("random-large", N, M, A, B);
+    };
+
+    free(B);
+    free(A);
 }
 
+#endif
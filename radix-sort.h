@@ -0,0 +1,58 @@
+/*
+ * LSD radix sort for long long keys, shared by the puzzle programs.
+ *
+ * The keys are sorted one byte at a time, least significant byte first, by
+ * stable counting passes back and forth between the keys and a caller
+ * supplied scratch buffer of the same length.  All eight histograms are
+ * gathered in a single read of the keys, and passes over a byte which is the
+ * same for every key are skipped, so keys of limited range (e.g. below 2^40)
+ * cost fewer passes.  Callers sorting several arrays can reuse one scratch
+ * buffer for all of them.
+ */
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <string.h>
+
+
+// flipping the sign bit makes the byte order agree with the signed order
+#define RADIX_BYTE(k,b)     ( (int)((((unsigned long long)(k) ^ (1ULL << 63)) >> (8*(b))) & 0xff) )
+
+
+/*
+ * Sort key[0..n) in ascending order using scratch[0..n) as temporary space.
+ */
+static void radix_sort_ll(long long *key, long long n, long long *scratch) {
+    long long count[8][256];
+    long long *src = key, *dst = scratch, *tmp;
+
+    if (n < 2)
+        return;
+
+    memset(count, 0, sizeof count);
+    for (long long i = 0; i < n; i++)
+        for (int b = 0; b < 8; b++)
+            count[b][RADIX_BYTE(key[i],b)]++;
+
+    for (int b = 0; b < 8; b++) {
+        long long offset = 0, c;
+
+        if (count[b][RADIX_BYTE(key[0],b)] == n)
+            continue;
+
+        for (int v = 0; v < 256; v++)
+            c = count[b][v], count[b][v] = offset, offset += c;
+
+        for (long long i = 0; i < n; i++)
+            dst[count[b][RADIX_BYTE(src[i],b)]++] = src[i];
+
+        tmp = src, src = dst, dst = tmp;
+    };
+
+    if (src != key)
+        memcpy(key, src, n * sizeof *key);
+}
+
+
+#endif
@@ -27,6 +27,10 @@
 
 #include <stdio.h>
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 #define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
 #define ABS(x)      ( (x) >= 0 ? (x) : -(x) )
@@ -42,9 +46,25 @@ long long getMinCodeEntryTime(int N, int M, int *C) {
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %lld, expected = %d\n", 
         getMinCodeEntryTime(3, 3, (int []){1,2,3}), 2);
     printf("result = %lld, expected = %d\n", 
         getMinCodeEntryTime(10, 4, (int []){9,4,4,8}), 11);
 }
+
+#else
+
+int main(int argc, char **argv) {
+    int N = 50000000, M = 1000;
+    int C[M];
+
+    bench_seed(1);
+    for (int i = 0; i < M; i++)
+        C[i] = bench_range(1, N);
+    BENCH_CASE("random", M, 100, , getMinCodeEntryTime(N, M, C));
+}
+
+#endif
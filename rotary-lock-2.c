@@ -59,6 +59,10 @@
 
 #include <stdio.h>
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 #define MIN(x,y)    ( (x) < (y) ? (x) : (y) )
 #define ABS(x)      ( (x) >= 0 ? (x) : -(x) )
@@ -84,6 +88,8 @@ long long getMinCodeEntryTime(int N, int M, int *C) {
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %lld, expected = %d\n", 
         getMinCodeEntryTime(3, 3, (int []){1,2,3}), 2);
@@ -92,3 +98,18 @@ int main(int argc, char **argv) {
     printf("result = %lld, expected = %d\n", 
         getMinCodeEntryTime(5, 4, (int []){3,4,3,4}), 4);
 }
+
+#else
+
+int main(int argc, char **argv) {
+    // the recursion is exponential in M, so stay well below M = 3,000
+    int N = 1000000000, M = 20;
+    int C[M];
+
+    bench_seed(1);
+    for (int i = 0; i < M; i++)
+        C[i] = bench_range(1, N);
+    BENCH_CASE("random", M, 3, , getMinCodeEntryTime(N, M, C));
+}
+
+#endif
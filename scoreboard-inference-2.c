@@ -28,6 +28,10 @@
 
 #include <stdio.h>
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 int getMinProblemCount(int N, int *S) {
     int max = 0, max_ = 0;
@@ -51,6 +55,8 @@ int getMinProblemCount(int N, int *S) {
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getMinProblemCount(5, (int []){1,2,3,4,5}), 3);
@@ -72,3 +78,18 @@ int main(int argc, char **argv) {
         getMinProblemCount(4, (int []){2,4,5,7}), 3);
 }
 
+#else
+
+int main(int argc, char **argv) {
+    int N = 500000;
+    int *S = malloc(N * sizeof *S);
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        S[i] = bench_range(1, 1000000000);
+    BENCH_CASE("random", N, 5, , getMinProblemCount(N, S));
+
+    free(S);
+}
+
+#endif
@@ -61,34 +61,36 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "grid.h"
 
-#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
+#ifdef BENCH
+#include "bench.h"
+#endif
 
 
-int getMaxCollectableCoins(int R, int C, char **G) {
-    int *col_coins[R], *end[R];
-    int *max_col_coins = calloc(R, sizeof *max_col_coins);
-
-    col_coins[0] = calloc(R*C, sizeof *col_coins[0]);
-    end[0] = calloc(R*C, sizeof *end[0]);
-    for (int row = 1; row < R; row++) {
-        col_coins[row] = col_coins[row-1] + C;
-        end[row] = end[row-1] + C;
-    };
+#define MAX(x,y)    ( (x) > (y) ? (x) : (y) )
 
-    // mark last row as end
-    for (int col = 0; col < C; col++) {
-        end[R-1][col] = 1;
-    };
 
-    // go through rows backwards and fill col_coins[] and end[]
+/*
+ * Same as getMaxCollectableCoins() for a grid mapped or wrapped by grid.h.
+ */
+int getMaxCollectableCoinsGrid(const grid_t *g) {
+    int R = g->rows, C = g->cols, result;
+    // leaving the grid at the bottom collects nothing more
+    int *max_col_coins = calloc(R+1, sizeof *max_col_coins);
+    int *row_coins = malloc(C * sizeof *row_coins);
+
+    // go through rows backwards, each cell only needs the best of the row below
     for (int row = R-1; row >= 0; row--) {
-        int row_coins[C], row_end, row_coins_total = -1;
+        const char *cells = grid_row(g, row);
+        int row_end, row_coins_total = -1;
 
         for (int col = 0; col < C; col++) {
-            switch (G[row][col]) {
+            int col_coins = 0, end = 0;
+
+            switch (cells[col]) {
             case '*':
-                col_coins[row][col] = 1;
+                col_coins = 1;
                 break;
             case '>':
                 // only search once per row
@@ -98,7 +100,7 @@ int getMaxCollectableCoins(int R, int C, char **G) {
 
                     row_coins_total = 0;
                     for (int j = 0; j < C; j++) {
-                        switch (G[row][j]) {
+                        switch (cells[j]) {
                         case '*':
                             row_coins_total++;
                             break;
@@ -113,7 +115,7 @@ int getMaxCollectableCoins(int R, int C, char **G) {
                         // ends in an infinite loop
                         row_end = 1;
                         for (int j = 0; j < C; j++) {
-                            if (G[row][j] == '>')
+                            if (cells[j] == '>')
                                 row_coins[j] = row_coins_total;
                         };
                     } else {
@@ -122,7 +124,7 @@ int getMaxCollectableCoins(int R, int C, char **G) {
                         row_end = 0;
                         int coin_count = 0;
                         for (int j = C-1; j >= 0; j--) {
-                            switch (G[row][(vcol+j)%C]) {
+                            switch (cells[(vcol+j)%C]) {
                             case '*':
                                 coin_count++;
                                 break;
@@ -137,22 +139,40 @@ int getMaxCollectableCoins(int R, int C, char **G) {
                     };
                 };
 
-                col_coins[row][col] = row_coins[col];
-                end[row][col] = row_end;
+                col_coins = row_coins[col];
+                end = row_end;
                 break;
             };
 
-            if (!end[row][col])
-                col_coins[row][col] += max_col_coins[row+1];
+            if (!end)
+                col_coins += max_col_coins[row+1];
 
-            max_col_coins[row] = MAX(max_col_coins[row], col_coins[row][col]);
+            max_col_coins[row] = MAX(max_col_coins[row], col_coins);
         };
     };
 
-    return max_col_coins[0];
+    result = max_col_coins[0];
+    free(row_coins);
+    free(max_col_coins);
+
+    return result;
 }
 
 
+int getMaxCollectableCoins(int R, int C, char **G) {
+    grid_t g;
+    int result;
+
+    grid_wrap(&g, R, C, G);
+    result = getMaxCollectableCoinsGrid(&g);
+    grid_free(&g);
+
+    return result;
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n",
         getMaxCollectableCoins(3, 4, (char *[]){".***", "**v>", ".*.."}), 4);
@@ -162,5 +182,80 @@ int main(int argc, char **argv) {
         getMaxCollectableCoins(2, 2, (char *[]){">>", "**"}), 0);
     printf("result = %d, expected = %d\n",
         getMaxCollectableCoins(4, 6, (char *[]){">*v*>*", "*v*v>*", ".*>..*", ".*..*v"}), 6);
+
+    // a conveyor in the last row that leaves the grid through a 'v', with
+    // nothing below it to collect
+    printf("result = %d, expected = %d\n",
+        getMaxCollectableCoins(2, 4, (char *[]){"....", ">*v*"}), 1);
+
+    // the last sample mapped from a text file
+    char path[] = "/tmp/slippery-trip-XXXXXX";
+    FILE *f = fdopen(mkstemp(path), "w");
+    grid_t g;
+
+    fputs(">*v*>*\n*v*v>*\n.*>..*\n.*..*v\n", f);
+    fclose(f);
+    if (grid_open(&g, path) == 0) {
+        printf("result = %d, expected = %d\n", getMaxCollectableCoinsGrid(&g), 6);
+        grid_free(&g);
+    } else {
+        printf("result = %s, expected = %s\n", "no grid", "grid");
+    };
+    unlink(path);
+}
+
+#else
+
+void bench_grid(const char *name, int R, int C) {
+    char *cells = malloc((size_t)R*C);
+    grid_t g = { .rows = R, .cols = C, .stride = C, .cells = cells, .base = cells };
+
+    for (size_t i = 0; i < (size_t)R*C; i++)
+        cells[i] = ".*>v"[bench_range(0, 3)];
+    BENCH_CASE(name, (long long)R*C, 5, , getMaxCollectableCoinsGrid(&g));
+
+    grid_free(&g);
+}
+
+
+/*
+ * Map the grid saved at path and solve it.
+ */
+int solveFile(const char *path) {
+    grid_t g;
+    int result;
+
+    if (grid_open(&g, path) != 0)
+        return -1;
+    result = getMaxCollectableCoinsGrid(&g);
+    grid_free(&g);
+
+    return result;
+}
+
+
+int main(int argc, char **argv) {
+    bench_seed(1);
+    bench_grid("square", 894, 894);
+    bench_seed(2);
+    bench_grid("wide", 2, 400000);
+    bench_seed(3);
+    bench_grid("tall", 400000, 2);
+
+    // far beyond the constraints, from memory and mapped from a file
+    int R = 10000, C = 10000;
+    char *cells = malloc((size_t)R*C), path[] = "/tmp/slippery-trip-XXXXXX";
+    grid_t g = { .rows = R, .cols = C, .stride = C, .cells = cells, .base = cells };
+
+    bench_seed(4);
+    for (size_t i = 0; i < (size_t)R*C; i++)
+        cells[i] = ".*>v"[bench_rand() % 4];
+    BENCH_CASE("10000x10000", (long long)R*C, 3, , getMaxCollectableCoinsGrid(&g));
+    close(mkstemp(path));
+    grid_save(&g, path);
+    grid_free(&g);
+    BENCH_CASE("10000x10000-file", (long long)R*C, 3, , solveFile(path));
+    unlink(path);
 }
 
+#endif
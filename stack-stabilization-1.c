@@ -32,6 +32,10 @@
 
 #include <stdio.h>
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 int getMinimumDeflatedDiscCount(int N, int *R) {
     int result = 0;
@@ -53,6 +57,8 @@ int getMinimumDeflatedDiscCount(int N, int *R) {
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     int R1[] = { 2, 5, 3, 6, 5 };
     int R2[] = { 100, 100, 100 };
@@ -66,3 +72,17 @@ int main(int argc, char **argv) {
             getMinimumDeflatedDiscCount(4, R3), -1);
 }
 
+#else
+
+int main(int argc, char **argv) {
+    int N = 50;
+    int R0[N], R[N];
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        R0[i] = bench_range(1, 1000000000);
+    BENCH_CASE("random", N, 1000, memcpy(R, R0, sizeof R),
+        getMinimumDeflatedDiscCount(N, R));
+}
+
+#endif
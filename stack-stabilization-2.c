@@ -69,6 +69,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 #define ENTRY(T,i,j) ( (T)->values[i*(T)->cols+j] )
 
@@ -186,6 +190,8 @@ long long getMinimumSecondsRequired(int N, int *R, int A, int B) {
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %d, expected = %d\n\n",
             getMinimumSecondsRequired(3, (int []){3, 2, 1}, 2, 1), 6);
@@ -203,3 +209,17 @@ int main(int argc, char **argv) {
             getMinimumSecondsRequired(6, (int []){6, 5, 2, 4, 4, 7}, 1, 1), 10);
 }
 
+#else
+
+int main(int argc, char **argv) {
+    int N = 50;
+    int R[N];
+
+    bench_seed(1);
+    for (int i = 0; i < N; i++)
+        R[i] = bench_range(1, 1000000000);
+    BENCH_CASE("random", N, 100, ,
+        getMinimumSecondsRequired(N, R, bench_range(1, 100), bench_range(1, 100)));
+}
+
+#endif
@@ -41,17 +41,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "radix-sort.h"
 
-int ll_cmp(const void *x, const void *y) {
-    return *(const long long *)x > *(const long long *)y;
-}
+#ifdef BENCH
+#include "bench.h"
+#endif
 
 
-long long getSecondsElapsed(long long C, int N, long long *A, long long *B, long long K) {
+/*
+ * Same as getSecondsElapsed() with scratch[0..N) as space for sorting, so
+ * callers solving many cases can allocate it once.
+ */
+long long getSecondsElapsedScratch(long long C, int N, long long *A, long long *B, long long K,
+        long long *scratch)
+{
     long long result;
 
-    qsort(A, N, sizeof *A, ll_cmp);
-    qsort(B, N, sizeof *B, ll_cmp);
+    // tunnels don't overlap, so their starts and ends can be sorted apart
+    radix_sort_ll(A, N, scratch);
+    radix_sort_ll(B, N, scratch);
 
     long long tunnel_time_per_round = 0;
     for (int i = 0; i < N; i++)
@@ -80,6 +88,17 @@ long long getSecondsElapsed(long long C, int N, long long *A, long long *B, long
 }
 
 
+long long getSecondsElapsed(long long C, int N, long long *A, long long *B, long long K) {
+    long long *scratch = malloc(N * sizeof *scratch);
+    long long result = getSecondsElapsedScratch(C, N, A, B, K, scratch);
+
+    free(scratch);
+    return result;
+}
+
+
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("result = %lld, expected = %d\n",
         getSecondsElapsed(10, 2, (long long []){1,6}, (long long []){3,7}, 7), 22);
@@ -87,3 +106,37 @@ int main(int argc, char **argv) {
         getSecondsElapsed(50, 3, (long long []){39,19,28}, (long long []){49,27,35}, 15), 35);
 }
 
+#else
+
+int main(int argc, char **argv) {
+    long long C = 1000000000000LL, K = 1000000000000LL;
+    int N = 500000;
+    long long *A0 = malloc(N * sizeof *A0), *B0 = malloc(N * sizeof *B0);
+    long long *A = malloc(N * sizeof *A), *B = malloc(N * sizeof *B);
+    long long pos = 0;
+
+    // tunnels neither touching each other nor position 0
+    bench_seed(1);
+    for (int i = 0; i < N; i++) {
+        A0[i] = pos += bench_range(1, C / (2*N+1));
+        B0[i] = pos += bench_range(1, C / (2*N+1));
+    };
+    bench_shuffle_ll(A0, N);
+    bench_shuffle_ll(B0, N);
+    BENCH_CASE("random", N, 5,
+        (memcpy(A, A0, N * sizeof *A), memcpy(B, B0, N * sizeof *B)),
+        getSecondsElapsed(C, N, A, B, K));
+
+    long long *scratch = malloc(N * sizeof *scratch);
+    BENCH_CASE("random-reuse", N, 5,
+        (memcpy(A, A0, N * sizeof *A), memcpy(B, B0, N * sizeof *B)),
+        getSecondsElapsedScratch(C, N, A, B, K, scratch));
+    free(scratch);
+
+    free(B);
+    free(A);
+    free(B0);
+    free(A0);
+}
+
+#endif
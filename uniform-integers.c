@@ -20,6 +20,10 @@
 
 #include <stdio.h>
 
+#ifdef BENCH
+#include "bench.h"
+#endif
+
 
 int getUniformIntegerCountInInterval(long long A, long long B) {
     int An = 1, Ad;
@@ -37,6 +41,8 @@ int getUniformIntegerCountInInterval(long long A, long long B) {
 }
 
 
+#ifndef BENCH
+
 int main(int argc, char **argv) {
     printf("A = %lld, B = %lld, result = %d, expected = %d\n",
             75, 300, getUniformIntegerCountInInterval(75, 300), 5);
@@ -47,3 +53,31 @@ int main(int argc, char **argv) {
             getUniformIntegerCountInInterval(999999999999, 999999999999), 1);
 }
 
+#else
+
+long long countUniformIntegers(int Q, long long *A, long long *B) {
+    long long result = 0;
+
+    for (int i = 0; i < Q; i++)
+        result += getUniformIntegerCountInInterval(A[i], B[i]);
+
+    return result;
+}
+
+
+int main(int argc, char **argv) {
+    int Q = 1000000;
+    long long *A = malloc(Q * sizeof *A), *B = malloc(Q * sizeof *B);
+
+    bench_seed(1);
+    for (int i = 0; i < Q; i++) {
+        A[i] = bench_range(1, 1000000000000LL);
+        B[i] = bench_range(A[i], 1000000000000LL);
+    };
+    BENCH_CASE("random", Q, 5, , countUniformIntegers(Q, A, B));
+
+    free(B);
+    free(A);
+}
+
+#endif